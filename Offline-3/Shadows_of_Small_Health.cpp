@@ -14,8 +14,112 @@
   Compilation:
     g++ -pthread Shadows_of_Small_Health.cpp -o Shadows_of_Small_Health.cpp.out
 
+    Add -DLOCK_PROFILE to record per-lock acquisition, contention, wait and hold statistics
+    and print a report sorted by total wait time when the simulation ends.
+
+    Add -DPHASE_COUNTERS to open perf_event counters (cycles, instructions, cache misses, context
+    switches, page faults) in every operative thread and attribute their deltas to the operative's
+    phases: arrival wait, station wait, typing, group wait, logbook. A per-phase summary is printed
+    when the simulation ends. Counters the kernel or the machine does not provide (e.g. hardware
+    counters in most VMs) are reported as n/a; kernel-side counting needs perf_event_paranoid <= 1.
+    Each thread's counters form one perf group read in a single call, and are merged when its
+    operative finishes. The descriptor limit is raised to its hard maximum; threads beyond what it
+    allows at once run uncounted and are reported as such rather than failing.
+
   Usage:
-    ./Shadows_of_Small_Health.cpp.out <input_file> <output_file>
+    ./Shadows_of_Small_Health.cpp.out <input_file> <output_file> [options]
+
+  Options:
+    --trace=<workload_file>
+    --stack-kb=<size>
+    --policy=<broadcast|fifo|leader|unit>
+    --open=<rate>,<duration_s>[,<warmup_s>]
+    --capacity=<slo_ms>[,<virtual_duration_s>]
+    --replicate=<K>
+    --staff=<poll|event>
+    --timeline=<json_file>
+    --shards=<K>
+    --combine
+    --log-cost=<batch_ms>,<entry_ms>
+    --stamp=<us|ns>
+
+    --stack-kb enables the low-footprint mode for very large N: operative threads get stacks of the
+    given size without guard pages, and a report of resident memory per operative is printed to stderr
+    once all operatives are started (trace mode reports peak RSS per peak in-flight operative at the end).
+
+    --policy chooses which waiting operative gets a station when it is released. broadcast (the default)
+    wakes every waiter and lets the scheduler decide; fifo serves in arrival order; leader serves unit
+    leaders first; unit serves members of the unit with the most finished members first, since a unit
+    is only as fast as its slowest member. With --policy, unit completion times and the makespan are
+    printed when the run ends so that policies can be compared.
+
+    --open runs an open system instead of a closed batch: operatives arrive as a Poisson process at
+    <rate> per second for <duration_s> seconds (N from the input file is ignored), units form in
+    arrival order, and staff keep reviewing until the last operative is done. Arrivals after the
+    warm-up window (default 20% of the duration) are measured: steady-state throughput, time-averaged
+    queue lengths (sampled at arrival instants, which see time averages for Poisson arrivals) and
+    percentiles of the arrival-to-logbook latency are printed when the run ends.
+
+    --capacity does not start any threads. It replays the same operative lifecycle in virtual time
+    (a discrete-event model with the same delay distributions and the --policy station order; staff
+    reviews take no virtual time and are left out) and binary-searches the highest Poisson arrival
+    rate whose p99 arrival-to-logbook latency stays within <slo_ms>. Each probe simulates
+    <virtual_duration_s> seconds (default 600) with common random numbers, so probes differ only in
+    rate. The saturation rate and the most utilized resource at that rate (a station or the logbook)
+    are printed.
+
+    --replicate runs K independently seeded replicas of the closed batch (N operatives from the input
+    file) in the same virtual-time model, spread over one worker thread per online CPU. The mean,
+    standard deviation and 95% confidence interval across replicas are printed for the makespan,
+    the operations completed at ten points of the mean makespan, and the p50/p95/p99 station waits.
+
+    --staff=event makes the intelligence staff event-driven instead of reviewing on a timer. Each staff
+    member subscribes to the logbook with its own eventfd; every logbook commit is published to all
+    subscribers and a staff member blocks in read() until there is something new to review. A burst of
+    commits while a review is in progress is coalesced into one wakeup (eventfd counters add up and one
+    read drains them), and shutdown is a final publish, so staff exit as soon as the run is done;
+    commits coalesced into that last wakeup get one more review first.
+    The number of commits published and reviews made is printed to stderr at the end.
+
+    --timeline writes a Chrome Trace Event JSON file (open it in chrome://tracing or ui.perfetto.dev)
+    with one track per operative (waiting, typing, group-wait and, for leaders, logging slices), one
+    track per station (which operative was typing) and one per staff member (reviews). Each operative
+    writes its slices when it finishes, so the file is streamed and memory does not grow with N.
+
+    --shards splits the logbook into K shards, each with its own reader-writer semaphore pair and
+    operation counter; unit u's leader writes to shard u % K, so up to K leaders write at once. Staff
+    reviews take read access to every shard in order and report the total. With --shards, the number
+    of commits and the mean lock wait per shard and the writer throughput are printed at the end;
+    compare runs with different K to see the scaling. The --capacity and --replicate models use the
+    same sharding.
+
+    --combine turns logbook writes into flat-combining group commits: a leader publishes its entry on
+    its shard's publication list and then waits for wrt; whichever leader gets wrt takes every pending
+    entry and commits them in one batch, and leaders whose entry was already committed release wrt at
+    once. --log-cost sets the simulated logbook cost to <batch_ms> per write plus <entry_ms> per entry
+    (without it a write costs the usual random time and entries are free); it applies to plain writes
+    too, so runs with and without --combine can be compared. With either option the number of
+    batches, the mean batch size, the mean lock wait (request to shard lock) and the mean commit
+    latency (request to commit, which adds the write and time spent in another leader's batch) are
+    printed at the end.
+
+    --stamp prefixes every output line with "#<seq> <time><unit> ", where seq is a global event
+    sequence number and time is CLOCK_MONOTONIC_RAW since the start of the run in microseconds or
+    nanoseconds. Both are taken while holding output_mutex, so the file is in sequence order and the
+    stamps never go backwards (the millisecond "at time" values inside the messages are taken before
+    the lock and can). critical_path_analyzer.cpp uses the stamps when they are present.
+
+    --trace replays operative arrivals from a workload file instead of drawing them at random.
+    N is then the number of records in the file; M, x and y still come from the input file.
+    The workload file is memory-mapped and parsed lazily, one chunk of records at a time.
+    Records are (arrival_us, station, typing_us), where station 0 means the default ID % 4 + 1.
+    Two formats are accepted:
+        CSV: one "arrival_us,station,typing_us" record per line (lines not starting with a digit are skipped)
+        Binary: the 8-byte magic "SOSHTRC1" followed by packed little-endian
+                {uint64 arrival_us; uint32 station; uint32 typing_us} records
+    Records should be roughly sorted by arrival; disorder within TRACE_REORDER_WINDOW records is repaired.
+    The file is checked before the run starts: a typing_us above INT_MAX is rejected with its line
+    (CSV) or record number (binary).
 
   Input:
     N M
@@ -42,168 +146,2018 @@
 #include <cstdlib>
 #include <ctime>
 #include <string>
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <queue>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <sys/eventfd.h>
+#ifdef PHASE_COUNTERS
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+int N, M, x, y;
+int G;
+
+pthread_mutex_t station_mutex[4];
+pthread_cond_t station_cv[4];
+bool station_available[4] = {true, true, true, true};
+
+// All state of one group lives together, starting on its own cache line
+struct alignas(64) GroupState
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;
+    int counter;
+    long long recreated_at; // ms, when the leader saw all members finish
+    long long logged_at;    // ms, when the unit's logbook entry was written; -1 until then
+    long long logged_at_us;
+    long long ready_at_us; // When the leader requested the logbook
+};
+
+enum StationPolicy
+{
+    POLICY_BROADCAST,
+    POLICY_FIFO,
+    POLICY_LEADER_FIRST,
+    POLICY_UNIT_FIRST
+};
+
+StationPolicy station_policy = POLICY_BROADCAST;
+bool report_schedule = false;
+
+// An operative queued for a station; lives on the waiting operative's stack
+struct StationWaiter
+{
+    long id;
+    int group_id;
+    bool leader;
+    long seq;
+    bool granted;
+    pthread_cond_t cv;
+};
+
+vector<StationWaiter *> station_queue[4];
+long station_seq[4];
+
+// Queue lengths sampled by the open-system mode
+int station_waiting[4];  // Protected by station_mutex
+int logbook_waiting = 0; // Leaders blocked on wrt, updated atomically
+
+// Open-system mode parameters and per-operative arrival times (us)
+double open_rate = 0;
+double open_duration = 0;
+double open_warmup = -1;
+vector<long long> open_arrival_us;
+long open_arrivals = 0;
+double open_station_samples[4], open_logbook_samples;
+long open_samples = 0;
+
+GroupState *groups;
+
+// One readers-preference logbook per shard; unit u is written to shard u % logbook_shard_count
+struct alignas(64) LogbookShard
+{
+    sem_t wrt;   // Semaphore for writers (binary semaphore)
+    sem_t mutex; // Semaphore for read_count protection
+    int read_count;
+    int completed_operations;
+    long long writer_wait_us; // Leaders' total wait for wrt, updated while holding wrt
+    int batches;              // Writes; fewer than completed_operations when entries are combined
+    struct LogbookRequest *pending; // Flat-combining publication list, pushed lock-free
+};
+
+struct LogbookRequest
+{
+    int group_id;
+    bool committed; // Set by the combiner while holding wrt
+    LogbookRequest *next;
+};
+
+LogbookShard *logbook;
+int logbook_shard_count = 1;
+bool report_logbook = false;
+
+// Flat combining and the logbook cost model; a negative batch cost means the random writing time
+bool logbook_combining = false;
+long long log_batch_us = -1;
+long long log_entry_us = 0;
+
+bool simulation_running = true;
+
+// Event-driven staff: one eventfd per subscriber, written on every logbook commit
+bool staff_event_driven = false;
+int staff_eventfd[2] = {-1, -1};
+long logbook_commits_published = 0;
+long staff_reviews = 0;
+
+pthread_mutex_t output_mutex;
+auto start_time = chrono::high_resolution_clock::now();
+
+// High-resolution event stamps: 0 = off, otherwise nanoseconds per printed unit (1000 or 1)
+long stamp_divisor = 0;
+const char *stamp_unit = "";
+struct timespec stamp_start;
+unsigned long event_seq = 0;
+
+struct Operative
+{
+    long id;
+    int station_id;
+    bool dispatched; // Arrival already handled by the trace or open-system dispatcher
+    int typing_us;   // Typing time of a dispatched operative, -1 to draw it like the others
+};
+
+#define TRACE_CHUNK_RECORDS 4096   // Records parsed per chunk of the mapped workload file
+#define TRACE_REORDER_WINDOW 65536 // Records buffered to restore timestamp order
+#define TRACE_MAGIC "SOSHTRC1"
+
+#define OPERATIVE_ARENA_SLAB 4096 // Operatives allocated per arena slab
+
+// Operative records are carved from large slabs and recycled through a free list,
+// so a long replay does not go through the general-purpose allocator per operative
+class OperativeArena
+{
+public:
+    OperativeArena() : free_list(NULL)
+    {
+        pthread_mutex_init(&arena_mutex, NULL);
+    }
+
+    ~OperativeArena()
+    {
+        for (Slot *slab : slabs)
+            delete[] slab;
+        pthread_mutex_destroy(&arena_mutex);
+    }
+
+    Operative *allocate()
+    {
+        pthread_mutex_lock(&arena_mutex);
+        if (free_list == NULL)
+        {
+            Slot *slab = new Slot[OPERATIVE_ARENA_SLAB];
+            for (int i = 0; i < OPERATIVE_ARENA_SLAB; i++)
+            {
+                slab[i].next = free_list;
+                free_list = &slab[i];
+            }
+            slabs.push_back(slab);
+        }
+        Slot *slot = free_list;
+        free_list = slot->next;
+        pthread_mutex_unlock(&arena_mutex);
+        return &slot->operative;
+    }
+
+    void release(Operative *op)
+    {
+        Slot *slot = (Slot *)op;
+        pthread_mutex_lock(&arena_mutex);
+        slot->next = free_list;
+        free_list = slot;
+        pthread_mutex_unlock(&arena_mutex);
+    }
+
+private:
+    union Slot
+    {
+        Operative operative;
+        Slot *next;
+    };
+
+    vector<Slot *> slabs;
+    Slot *free_list;
+    pthread_mutex_t arena_mutex;
+};
+
+OperativeArena operative_arena;
+
+// Stack size for operative threads in low-footprint mode, 0 for the system default
+size_t operative_stack_size = 0;
+long operatives_in_flight_peak = 0;
+
+// Dispatched operatives are detached; the dispatcher waits for this count to drop to zero
+long operatives_in_flight = 0;
+pthread_mutex_t in_flight_mutex;
+pthread_cond_t in_flight_cv;
+
+// Lock identifiers used by the lock profiler: 4 stations, then the global locks, then one per group
+enum LockId
+{
+    LOCK_STATION = 0,
+    LOCK_OUTPUT = 4,
+    LOCK_WRT,
+    LOCK_MUTEX,
+    LOCK_GROUP
+};
+
+// Shard 0 keeps the LOCK_WRT / LOCK_MUTEX ids; further shards are numbered after the groups
+int shard_lock_id(int shard, bool writer_semaphore)
+{
+    if (shard == 0)
+        return writer_semaphore ? LOCK_WRT : LOCK_MUTEX;
+    return LOCK_GROUP + G + 2 * (shard - 1) + (writer_semaphore ? 0 : 1);
+}
+
+#ifdef LOCK_PROFILE
+#define LOCK_PROFILE_TOP 20 // Number of individual locks listed in the report
+
+struct LockStats
+{
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;
+    uint64_t wait_total = 0; // TSC ticks
+    uint64_t wait_max = 0;   // TSC ticks
+    uint64_t hold_total = 0; // TSC ticks
+};
+
+vector<string> lock_names;
+vector<uint64_t> lock_held_since; // Written only by the current holder of the lock
+vector<LockStats> lock_totals;
+pthread_mutex_t lock_totals_mutex = PTHREAD_MUTEX_INITIALIZER;
+double tsc_ticks_per_us = 1.0;
+
+inline uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Each thread accumulates privately and merges into lock_totals when it is done (see flush)
+struct LockStatsBuffer
+{
+    unordered_map<int, LockStats> stats;
+
+    // Detached threads call this before they are counted out, since the thread-exit destructor
+    // may run after the main thread has already printed the report; the destructor is a fallback
+    void flush()
+    {
+        if (stats.empty())
+            return;
+        pthread_mutex_lock(&lock_totals_mutex);
+        for (auto &entry : stats)
+        {
+            LockStats &total = lock_totals[entry.first];
+            total.acquisitions += entry.second.acquisitions;
+            total.contended += entry.second.contended;
+            total.wait_total += entry.second.wait_total;
+            total.wait_max = max(total.wait_max, entry.second.wait_max);
+            total.hold_total += entry.second.hold_total;
+        }
+        pthread_mutex_unlock(&lock_totals_mutex);
+        stats.clear();
+    }
+
+    ~LockStatsBuffer()
+    {
+        flush();
+    }
+};
+
+thread_local LockStatsBuffer lock_stats_buffer;
+
+void lock_profile_init(int groups, int shards)
+{
+    for (int i = 0; i < 4; i++)
+        lock_names.push_back("station_mutex[" + to_string(i) + "]");
+    lock_names.push_back("output_mutex");
+    lock_names.push_back("wrt");
+    lock_names.push_back("mutex");
+    for (int i = 0; i < groups; i++)
+        lock_names.push_back("groups[" + to_string(i) + "].mutex");
+    for (int i = 1; i < shards; i++)
+    {
+        lock_names.push_back("logbook[" + to_string(i) + "].wrt");
+        lock_names.push_back("logbook[" + to_string(i) + "].mutex");
+    }
+    lock_held_since.assign(lock_names.size(), 0);
+    lock_totals.assign(lock_names.size(), LockStats());
+
+    // Calibrate the TSC against the steady clock
+    auto wall_begin = chrono::steady_clock::now();
+    uint64_t tsc_begin = read_tsc();
+    usleep(20000);
+    uint64_t tsc_end = read_tsc();
+    auto wall_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - wall_begin).count();
+    tsc_ticks_per_us = (double)(tsc_end - tsc_begin) / (double)wall_us;
+}
+
+void lock_acquired(int id, uint64_t request_tsc, bool contended)
+{
+    uint64_t now = read_tsc();
+    LockStats &stats = lock_stats_buffer.stats[id];
+    stats.acquisitions++;
+    if (contended)
+    {
+        stats.contended++;
+        stats.wait_total += now - request_tsc;
+        stats.wait_max = max(stats.wait_max, now - request_tsc);
+    }
+    lock_held_since[id] = now;
+}
+
+void lock_released(int id)
+{
+    lock_stats_buffer.stats[id].hold_total += read_tsc() - lock_held_since[id];
+}
+
+void profiled_mutex_lock(pthread_mutex_t *m, int id)
+{
+    uint64_t request_tsc = read_tsc();
+    bool contended = pthread_mutex_trylock(m) != 0;
+    if (contended)
+        pthread_mutex_lock(m);
+    lock_acquired(id, request_tsc, contended);
+}
+
+void profiled_mutex_unlock(pthread_mutex_t *m, int id)
+{
+    lock_released(id);
+    pthread_mutex_unlock(m);
+}
+
+// The mutex is not held while blocked on the condition variable, so that time is not hold time
+void profiled_cond_wait(pthread_cond_t *cv, pthread_mutex_t *m, int id)
+{
+    lock_released(id);
+    pthread_cond_wait(cv, m);
+    lock_held_since[id] = read_tsc();
+}
+
+void profiled_sem_wait(sem_t *s, int id)
+{
+    uint64_t request_tsc = read_tsc();
+    bool contended = sem_trywait(s) != 0;
+    if (contended)
+        sem_wait(s);
+    lock_acquired(id, request_tsc, contended);
+}
+
+// wrt may be posted by a different reader than the one that took it; the poster is charged the hold
+void profiled_sem_post(sem_t *s, int id)
+{
+    lock_released(id);
+    sem_post(s);
+}
+
+void lock_profile_report()
+{
+    vector<int> order;
+    for (int i = 0; i < (int)lock_totals.size(); i++)
+        if (lock_totals[i].acquisitions > 0)
+            order.push_back(i);
+    sort(order.begin(), order.end(), [](int a, int b)
+         { return lock_totals[a].wait_total > lock_totals[b].wait_total; });
+
+    cout << "Lock contention profile (sorted by total wait, times in us):" << endl;
+    cout << "lock\tacquisitions\tcontended\ttotal_wait\tmax_wait\ttotal_hold" << endl;
+    for (int i = 0; i < (int)order.size() && i < LOCK_PROFILE_TOP; i++)
+    {
+        const LockStats &s = lock_totals[order[i]];
+        cout << lock_names[order[i]] << "\t" << s.acquisitions << "\t" << s.contended << "\t"
+             << (long long)(s.wait_total / tsc_ticks_per_us) << "\t"
+             << (long long)(s.wait_max / tsc_ticks_per_us) << "\t"
+             << (long long)(s.hold_total / tsc_ticks_per_us) << endl;
+    }
+    if ((int)order.size() > LOCK_PROFILE_TOP)
+        cout << "(" << order.size() - LOCK_PROFILE_TOP << " more locks not shown)" << endl;
+}
+
+#define MUTEX_LOCK(m, id) profiled_mutex_lock(m, id)
+#define MUTEX_UNLOCK(m, id) profiled_mutex_unlock(m, id)
+#define COND_WAIT(cv, m, id) profiled_cond_wait(cv, m, id)
+#define SEM_WAIT(s, id) profiled_sem_wait(s, id)
+#define SEM_POST(s, id) profiled_sem_post(s, id)
+#else
+#define MUTEX_LOCK(m, id) pthread_mutex_lock(m)
+#define MUTEX_UNLOCK(m, id) pthread_mutex_unlock(m)
+#define COND_WAIT(cv, m, id) pthread_cond_wait(cv, m)
+#define SEM_WAIT(s, id) sem_wait(s)
+#define SEM_POST(s, id) sem_post(s)
+#endif
+
+enum Phase
+{
+    PHASE_ARRIVAL,
+    PHASE_STATION_WAIT,
+    PHASE_TYPING,
+    PHASE_GROUP_WAIT,
+    PHASE_LOGBOOK,
+    PHASE_COUNT,
+    PHASE_NONE = PHASE_COUNT
+};
+
+#ifdef PHASE_COUNTERS
+struct PhaseCounterDef
+{
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+};
+
+const PhaseCounterDef phase_counter_defs[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache_misses"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "ctx_switches"},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page_faults"},
+};
+const int PHASE_COUNTER_COUNT = sizeof(phase_counter_defs) / sizeof(phase_counter_defs[0]);
+const char *phase_names[PHASE_COUNT] = {"arrival wait", "station wait", "typing", "group wait", "logbook"};
+
+uint64_t phase_totals[PHASE_COUNT][PHASE_COUNTER_COUNT];
+uint64_t phase_time_ns[PHASE_COUNT];
+uint64_t phase_entries[PHASE_COUNT];
+long phase_counter_threads[PHASE_COUNTER_COUNT]; // Threads in which each counter could be opened
+long phase_threads = 0;
+long phase_threads_skipped = 0; // Threads left uncounted because the descriptor budget was used up
+pthread_mutex_t phase_totals_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Threads that may hold counters at once, so that large N cannot exhaust the descriptor table
+long phase_counter_budget = 0;
+long phase_counter_sets_open = 0;
+
+// Raises the descriptor limit as far as allowed and sizes the budget from it, keeping some
+// descriptors for files, eventfds and the timeline
+void phase_counter_init()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return;
+    if (limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+            getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    long usable = limit.rlim_cur == RLIM_INFINITY ? LONG_MAX : (long)limit.rlim_cur - 64;
+    phase_counter_budget = max(0L, usable / PHASE_COUNTER_COUNT);
+}
+
+int open_phase_counter(const PhaseCounterDef &def, int group_fd)
+{
+    // Counting kernel time as well gives context switches; fall back to user-only if not permitted
+    for (int exclude_kernel = 0; exclude_kernel <= 1; exclude_kernel++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = def.type;
+        attr.config = def.config;
+        attr.exclude_kernel = exclude_kernel;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+        if (fd >= 0)
+            return fd;
+        if (errno != EACCES && errno != EPERM)
+            return -1;
+    }
+    return -1;
+}
+
+// Counters of the calling thread, opened as one perf group at the first phase switch (the first
+// counter that opens leads it) so that a single read returns them all. Merged and closed by
+// flush() when the operative is done; the thread-exit destructor only catches what is left.
+struct PhaseCounterSet
+{
+    bool opened = false;
+    bool counted = false; // Holds a share of the descriptor budget
+    int current = PHASE_NONE;
+    int leader = -1;
+    int fd[PHASE_COUNTER_COUNT];
+    int slot[PHASE_COUNTER_COUNT]; // Position of each counter in the group read, -1 if not opened
+    int members = 0;
+    uint64_t last[PHASE_COUNTER_COUNT];
+    uint64_t last_ns = 0;
+    uint64_t totals[PHASE_COUNT][PHASE_COUNTER_COUNT] = {};
+    uint64_t time_ns[PHASE_COUNT] = {};
+    uint64_t entries[PHASE_COUNT] = {};
+
+    void open()
+    {
+        opened = true;
+        for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+        {
+            fd[k] = -1;
+            slot[k] = -1;
+        }
+        pthread_mutex_lock(&phase_totals_mutex);
+        counted = phase_counter_sets_open < phase_counter_budget;
+        if (counted)
+            phase_counter_sets_open++;
+        else
+            phase_threads_skipped++;
+        pthread_mutex_unlock(&phase_totals_mutex);
+        if (!counted)
+            return;
+        for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+        {
+            fd[k] = open_phase_counter(phase_counter_defs[k], leader);
+            if (fd[k] < 0)
+                continue;
+            if (leader < 0)
+                leader = fd[k];
+            slot[k] = members++;
+        }
+    }
+
+    // Current value of every counter, 0 for the ones that could not be opened
+    void read_counters(uint64_t now[PHASE_COUNTER_COUNT])
+    {
+        uint64_t values[1 + PHASE_COUNTER_COUNT]; // PERF_FORMAT_GROUP: nr, then one value per member
+        ssize_t wanted = (1 + members) * sizeof(uint64_t);
+        bool ok = leader >= 0 && read(leader, values, wanted) == wanted;
+        for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+            now[k] = ok && slot[k] >= 0 ? values[1 + slot[k]] : 0;
+    }
+
+    void flush()
+    {
+        if (!opened || !counted)
+            return;
+        pthread_mutex_lock(&phase_totals_mutex);
+        phase_threads++;
+        phase_counter_sets_open--;
+        for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+        {
+            if (fd[k] >= 0)
+                phase_counter_threads[k]++;
+        }
+        for (int p = 0; p < PHASE_COUNT; p++)
+        {
+            for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+                phase_totals[p][k] += totals[p][k];
+            phase_time_ns[p] += time_ns[p];
+            phase_entries[p] += entries[p];
+        }
+        pthread_mutex_unlock(&phase_totals_mutex);
+        for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+        {
+            if (fd[k] >= 0 && fd[k] != leader)
+                close(fd[k]);
+        }
+        if (leader >= 0)
+            close(leader);
+        counted = false;
+    }
+
+    ~PhaseCounterSet()
+    {
+        flush();
+    }
+};
+
+thread_local PhaseCounterSet phase_counters;
+
+// Ends the thread's current phase, charging it the counter deltas, and starts the next one
+void phase_switch(int next)
+{
+    PhaseCounterSet &set = phase_counters;
+    if (!set.opened)
+        set.open();
+    if (!set.counted)
+        return;
+    uint64_t now[PHASE_COUNTER_COUNT];
+    set.read_counters(now);
+    uint64_t now_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    if (set.current != PHASE_NONE)
+    {
+        for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+            set.totals[set.current][k] += now[k] - set.last[k];
+        set.time_ns[set.current] += now_ns - set.last_ns;
+        set.entries[set.current]++;
+    }
+    memcpy(set.last, now, sizeof(now));
+    set.last_ns = now_ns;
+    set.current = next;
+}
+
+void phase_counter_report()
+{
+    cout << "Phase counters (" << phase_threads << " operative threads):" << endl;
+    cout << "phase\tentries\ttime_us";
+    for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+        cout << "\t" << phase_counter_defs[k].name;
+    cout << endl;
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        cout << phase_names[p] << "\t" << phase_entries[p] << "\t" << phase_time_ns[p] / 1000;
+        for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+        {
+            if (phase_counter_threads[k] == 0)
+                cout << "\tn/a";
+            else
+                cout << "\t" << phase_totals[p][k];
+        }
+        cout << endl;
+    }
+    for (int k = 0; k < PHASE_COUNTER_COUNT; k++)
+    {
+        if (phase_counter_threads[k] > 0 && phase_counter_threads[k] < phase_threads)
+            cout << phase_counter_defs[k].name << " was only available in " << phase_counter_threads[k]
+                 << " of " << phase_threads << " threads" << endl;
+    }
+    if (phase_threads_skipped > 0)
+        cout << phase_threads_skipped << " threads were not counted: at most " << phase_counter_budget
+             << " may hold counters at once with the descriptor limit" << endl;
+}
+
+#define PHASE_SWITCH(p) phase_switch(p)
+#define PHASE_FLUSH() phase_counters.flush()
+#else
+#define PHASE_SWITCH(p)
+#define PHASE_FLUSH()
+#endif
+
+long long get_time()
+{
+    auto end_time = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+    long long elapsed_time_ms = duration.count();
+    return elapsed_time_ms;
+}
+
+void write_output(string message)
+{
+    MUTEX_LOCK(&output_mutex, LOCK_OUTPUT);
+    if (stamp_divisor > 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+        long long elapsed_ns = (now.tv_sec - stamp_start.tv_sec) * 1000000000LL + (now.tv_nsec - stamp_start.tv_nsec);
+        cout << "#" << __atomic_fetch_add(&event_seq, 1, __ATOMIC_RELAXED) << " " << elapsed_ns / stamp_divisor << stamp_unit << " ";
+    }
+    cout << message << endl;
+    MUTEX_UNLOCK(&output_mutex, LOCK_OUTPUT);
+}
+
+long resident_kb()
+{
+    long pages_total = 0, pages_resident = 0;
+    ifstream statm("/proc/self/statm");
+    statm >> pages_total >> pages_resident;
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Attributes for operative threads; low-footprint mode shrinks the stack and drops the guard page
+void init_operative_attr(pthread_attr_t *attr, bool detached)
+{
+    pthread_attr_init(attr);
+    if (detached)
+        pthread_attr_setdetachstate(attr, PTHREAD_CREATE_DETACHED);
+    if (operative_stack_size > 0)
+    {
+        pthread_attr_setstacksize(attr, operative_stack_size);
+        pthread_attr_setguardsize(attr, 0);
+    }
+}
+
+// Back off while the system is out of threads; running operatives will free some
+void create_operative_thread(pthread_t *thread, pthread_attr_t *attr, void *(*function)(void *), Operative *op)
+{
+    while (pthread_create(thread, attr, function, op) == EAGAIN)
+        usleep(1000);
+}
+
+long long get_time_us()
+{
+    auto end_time = chrono::high_resolution_clock::now();
+    return chrono::duration_cast<chrono::microseconds>(end_time - start_time).count();
+}
+
+// Chrome Trace Event output; pid 1 holds operatives, 2 stations, 3 staff
+FILE *timeline = NULL;
+pthread_mutex_t timeline_mutex = PTHREAD_MUTEX_INITIALIZER;
+bool timeline_empty = true;
+
+string timeline_slice(int pid, long tid, const string &name, long long begin_us, long long end_us)
+{
+    char buffer[160];
+    snprintf(buffer, sizeof(buffer), "{\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,\"name\":\"%s\",\"ts\":%lld,\"dur\":%lld}",
+             pid, tid, name.c_str(), begin_us, max(0LL, end_us - begin_us));
+    return buffer;
+}
+
+string timeline_name(int pid, long tid, const string &name)
+{
+    char buffer[160];
+    if (tid < 0)
+        snprintf(buffer, sizeof(buffer), "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}}",
+                 pid, name.c_str());
+    else
+        snprintf(buffer, sizeof(buffer), "{\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+                 pid, tid, name.c_str());
+    return buffer;
+}
+
+// Appends events (one per element) to the JSON array
+void timeline_write(const vector<string> &events)
+{
+    pthread_mutex_lock(&timeline_mutex);
+    for (const string &event : events)
+    {
+        fputs(timeline_empty ? "[\n" : ",\n", timeline);
+        fputs(event.c_str(), timeline);
+        timeline_empty = false;
+    }
+    pthread_mutex_unlock(&timeline_mutex);
+}
+
+bool timeline_open(const char *path)
+{
+    timeline = fopen(path, "w");
+    if (timeline == NULL)
+        return false;
+    setvbuf(timeline, NULL, _IOFBF, 1 << 20);
+    vector<string> names = {timeline_name(1, -1, "Operatives"), timeline_name(2, -1, "Stations"), timeline_name(3, -1, "Intelligence Staff")};
+    for (int i = 1; i <= 4; i++)
+        names.push_back(timeline_name(2, i, "Station " + to_string(i)));
+    for (int i = 1; i <= 2; i++)
+        names.push_back(timeline_name(3, i, "Staff " + to_string(i)));
+    timeline_write(names);
+    return true;
+}
+
+void timeline_close()
+{
+    fputs(timeline_empty ? "[]\n" : "\n]\n", timeline);
+    fclose(timeline);
+    timeline = NULL;
+}
+
+// Per-thread seed for the low-footprint generator; zero until the thread first draws
+thread_local unsigned lean_rng_state = 0;
+unsigned lean_rng_seed = 0;
+
+// Kept out of line: random_device and mt19937 need about 10 KB of stack, and stack probing
+// would touch all of it in any caller that inlined this, even in the low-footprint mode
+__attribute__((noinline)) int seeded_random_number()
+{
+    random_device rd;
+    mt19937 generator(rd());
+
+    // Lambda value for the Poisson distribution
+    double lambda = 10000.234;
+    poisson_distribution<int> poissonDist(lambda);
+    return poissonDist(generator);
+}
+
+int get_random_number()
+{
+    if (operative_stack_size == 0)
+        return seeded_random_number();
+
+    // The low-footprint mode keeps a 4-byte per-thread state instead
+    if (lean_rng_state == 0)
+        lean_rng_state = (lean_rng_seed ^ (unsigned)hash<pthread_t>()(pthread_self()) ^ (unsigned)get_time_us()) | 1;
+    minstd_rand generator(lean_rng_state);
+    poisson_distribution<int> poissonDist(10000.234);
+    int value = poissonDist(generator);
+    lean_rng_state = generator();
+    return value;
+}
+
+// Index into station_queue of the waiter the current policy serves next
+size_t pick_station_waiter(const vector<StationWaiter *> &queue)
+{
+    size_t best = 0;
+    for (size_t i = 1; i < queue.size(); i++)
+    {
+        const StationWaiter *a = queue[i], *b = queue[best];
+        bool better = a->seq < b->seq;
+        if (station_policy == POLICY_LEADER_FIRST && a->leader != b->leader)
+        {
+            better = a->leader;
+        }
+        else if (station_policy == POLICY_UNIT_FIRST)
+        {
+            // Unit counters are only a hint here, so they are read without the group lock
+            int done_a = __atomic_load_n(&groups[a->group_id].counter, __ATOMIC_RELAXED);
+            int done_b = __atomic_load_n(&groups[b->group_id].counter, __ATOMIC_RELAXED);
+            if (done_a != done_b)
+                better = done_a > done_b;
+        }
+        if (better)
+            best = i;
+    }
+    return best;
+}
+
+void acquire_station(long id, int group_id, bool leader, int station_index)
+{
+    int station_id = station_index + 1;
+    MUTEX_LOCK(&station_mutex[station_index], LOCK_STATION + station_index);
+    if (station_policy == POLICY_BROADCAST)
+    {
+        station_waiting[station_index]++;
+        while (!station_available[station_index])
+        {
+            write_output("Operative " + to_string(id) + " is waiting for station " + to_string(station_id) + ".");
+            COND_WAIT(&station_cv[station_index], &station_mutex[station_index], LOCK_STATION + station_index);
+        }
+        station_waiting[station_index]--;
+        station_available[station_index] = false;
+    }
+    else if (station_available[station_index])
+    {
+        station_available[station_index] = false;
+    }
+    else
+    {
+        // The releasing operative hands the station directly to the waiter it picks
+        write_output("Operative " + to_string(id) + " is waiting for station " + to_string(station_id) + ".");
+        StationWaiter waiter = {id, group_id, leader, station_seq[station_index]++, false, PTHREAD_COND_INITIALIZER};
+        station_queue[station_index].push_back(&waiter);
+        station_waiting[station_index]++;
+        while (!waiter.granted)
+        {
+            COND_WAIT(&waiter.cv, &station_mutex[station_index], LOCK_STATION + station_index);
+        }
+        station_waiting[station_index]--;
+        pthread_cond_destroy(&waiter.cv);
+    }
+    MUTEX_UNLOCK(&station_mutex[station_index], LOCK_STATION + station_index);
+}
+
+void release_station(int station_index)
+{
+    MUTEX_LOCK(&station_mutex[station_index], LOCK_STATION + station_index);
+    vector<StationWaiter *> &queue = station_queue[station_index];
+    if (station_policy == POLICY_BROADCAST || queue.empty())
+    {
+        station_available[station_index] = true;
+        pthread_cond_broadcast(&station_cv[station_index]);
+    }
+    else
+    {
+        size_t next = pick_station_waiter(queue);
+        StationWaiter *waiter = queue[next];
+        queue.erase(queue.begin() + next);
+        waiter->granted = true;
+        pthread_cond_signal(&waiter->cv);
+    }
+    MUTEX_UNLOCK(&station_mutex[station_index], LOCK_STATION + station_index);
+}
+
+void schedule_report()
+{
+    static const char *policy_names[] = {"broadcast", "fifo", "leader", "unit"};
+    long long makespan = 0, total = 0;
+    int units = 0;
+    cout << "Station policy: " << policy_names[station_policy] << endl;
+    for (int i = 0; i < N / M; i++)
+    {
+        if (groups[i].logged_at < 0)
+            continue;
+        cout << "Unit " << i + 1 << ": recreation done at " << groups[i].recreated_at << " ms, logged at " << groups[i].logged_at << " ms" << endl;
+        makespan = max(makespan, groups[i].logged_at);
+        total += groups[i].logged_at;
+        units++;
+    }
+    if (units > 0)
+        cout << "Mean unit completion: " << total / units << " ms" << endl;
+    cout << "Makespan: " << makespan << " ms" << endl;
+}
+
+void logbook_report()
+{
+    long long first_ready = LLONG_MAX, last_commit = 0, total_wait = 0;
+    int commits = 0;
+    for (int i = 0; i < G; i++)
+    {
+        if (groups[i].logged_at_us < 0)
+            continue;
+        first_ready = min(first_ready, groups[i].ready_at_us);
+        last_commit = max(last_commit, groups[i].logged_at_us);
+    }
+    cout << "Logbook shards: " << logbook_shard_count << endl;
+    for (int i = 0; i < logbook_shard_count; i++)
+    {
+        cout << "Shard " << i << ": " << logbook[i].completed_operations << " commits, mean lock wait "
+             << (logbook[i].completed_operations > 0 ? logbook[i].writer_wait_us / logbook[i].completed_operations / 1000.0 : 0) << " ms" << endl;
+        commits += logbook[i].completed_operations;
+        total_wait += logbook[i].writer_wait_us;
+    }
+    if (commits == 0)
+        return;
+    long long leader_wait = 0;
+    int batches = 0;
+    for (int i = 0; i < G; i++)
+        if (groups[i].logged_at_us >= 0)
+            leader_wait += groups[i].logged_at_us - groups[i].ready_at_us;
+    for (int i = 0; i < logbook_shard_count; i++)
+        batches += logbook[i].batches;
+    cout << "Logbook writes: " << batches << " batches for " << commits << " entries, mean batch size "
+         << (double)commits / batches << (logbook_combining ? " (flat combining)" : "") << endl;
+    // Lock wait is the time a leader waits for its shard's wrt; commit latency runs from the
+    // request to the entry being committed, so it also covers the write and, with combining, the
+    // time the entry sat in someone else's batch
+    cout << "Mean lock wait (request to shard lock): " << total_wait / commits / 1000.0 << " ms" << endl;
+    cout << "Mean commit latency (request to commit): " << leader_wait / commits / 1000.0 << " ms" << endl;
+    double span_s = (last_commit - first_ready) / 1e6;
+    cout << "Writer throughput: " << (span_s > 0 ? commits / span_s : 0) << " commits/s over " << span_s << " s" << endl;
+}
+
+void publish_logbook_commit()
+{
+    uint64_t one = 1;
+    for (int i = 0; i < 2; i++)
+    {
+        if (write(staff_eventfd[i], &one, sizeof(one)) != sizeof(one))
+            perror("eventfd write");
+    }
+}
+
+// Simulated time for one logbook write holding the given number of entries
+long long logbook_write_us(int entries)
+{
+    if (log_batch_us < 0)
+        return (get_random_number() % (y + 2) + 1) * 5000 + entries * log_entry_us;
+    return log_batch_us + entries * log_entry_us;
+}
+
+void commit_entry(int group_id)
+{
+    groups[group_id].logged_at = get_time();
+    groups[group_id].logged_at_us = get_time_us();
+    write_output("Unit " + to_string(group_id + 1) + " has completed intelligence distribution at time " + to_string(groups[group_id].logged_at));
+}
+
+void write_logbook_entry(int group_id)
+{
+    int shard = group_id % logbook_shard_count;
+    LogbookShard &book = logbook[shard];
+    LogbookRequest request = {group_id, false, NULL};
+    if (logbook_combining)
+    {
+        request.next = __atomic_load_n(&book.pending, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&book.pending, &request.next, &request, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+
+    // Writer entry protocol
+    long long wait_begin_us = get_time_us();
+    __atomic_add_fetch(&logbook_waiting, 1, __ATOMIC_RELAXED);
+    SEM_WAIT(&book.wrt, shard_lock_id(shard, true));
+    __atomic_sub_fetch(&logbook_waiting, 1, __ATOMIC_RELAXED);
+    book.writer_wait_us += get_time_us() - wait_begin_us;
+    if (request.committed)
+    {
+        // An earlier combiner already wrote this entry
+        SEM_POST(&book.wrt, shard_lock_id(shard, true));
+        return;
+    }
+
+    // Without combining the batch is just this entry; with it, everything published so far
+    vector<int> batch;
+    LogbookRequest *published = NULL;
+    if (logbook_combining)
+    {
+        published = __atomic_exchange_n(&book.pending, (LogbookRequest *)NULL, __ATOMIC_ACQUIRE);
+        for (LogbookRequest *r = published; r != NULL; r = r->next)
+            batch.push_back(r->group_id);
+        reverse(batch.begin(), batch.end()); // The list is LIFO; commit in publication order
+    }
+    else
+        batch.push_back(group_id);
+
+    usleep(logbook_write_us(batch.size()));
+    book.completed_operations += batch.size();
+    book.batches++;
+    for (int g : batch)
+        commit_entry(g);
+    // Requests live on their leaders' stacks and may vanish once marked, so read next first
+    for (LogbookRequest *r = published; r != NULL;)
+    {
+        LogbookRequest *next = r->next;
+        r->committed = true;
+        r = next;
+    }
+    SEM_POST(&book.wrt, shard_lock_id(shard, true));
+    if (staff_event_driven)
+    {
+        __atomic_add_fetch(&logbook_commits_published, batch.size(), __ATOMIC_RELEASE);
+        publish_logbook_commit();
+    }
+}
+
+void *operative_function(void *arg)
+{
+    Operative *op = (Operative *)arg;
+    long id = op->id;
+    PHASE_SWITCH(PHASE_ARRIVAL);
+    if (!op->dispatched)
+    {
+        int delay_arrival = get_random_number() % (x + 2) + 1;
+        usleep(delay_arrival * 5000);
+    }
+    int station_id = op->station_id;
+    int station_index = station_id - 1;
+    long long arrived_us = get_time_us();
+    write_output("Operative " + to_string(id) + " has arrived at typewriting station " + to_string(station_id) + " at time " + to_string(get_time()));
+    write_output("Operative " + to_string(id) + " is requesting station " + to_string(station_id) + ".");
+
+    int group_id = (id - 1) / M;
+    int leader_id = (group_id + 1) * M;
+
+    PHASE_SWITCH(PHASE_STATION_WAIT);
+    acquire_station(id, group_id, id == leader_id, station_index);
+    PHASE_SWITCH(PHASE_TYPING);
+    long long acquired_us = get_time_us();
+    write_output("Operative " + to_string(id) + " has acquired station " + to_string(station_id) + ".");
+
+    if (op->typing_us >= 0)
+    {
+        usleep(op->typing_us);
+    }
+    else
+    {
+        int typewriting_time = get_random_number() % (y + 2) + 1;
+        usleep(typewriting_time * 5000);
+    }
+    write_output("Operative " + to_string(id) + " has completed document recreation at station " + to_string(station_id) + " at time " + to_string(get_time()));
+
+    release_station(station_index);
+    PHASE_SWITCH(PHASE_GROUP_WAIT);
+    long long released_us = get_time_us();
+    long long group_done_us = released_us;
+    write_output("Operative " + to_string(id) + " has released station " + to_string(station_id) + ".");
+
+    if (id == leader_id)
+    {
+        write_output("Leader Operative " + to_string(id) + " is waiting for group members to finish.");
+        MUTEX_LOCK(&groups[group_id].mutex, LOCK_GROUP + group_id);
+        groups[group_id].counter++;
+        if (groups[group_id].counter < M)
+        {
+            while (groups[group_id].counter < M)
+            {
+                COND_WAIT(&groups[group_id].cv, &groups[group_id].mutex, LOCK_GROUP + group_id);
+            }
+        }
+        MUTEX_UNLOCK(&groups[group_id].mutex, LOCK_GROUP + group_id);
+        write_output("Leader Operative " + to_string(id) + " detected all group members finished.");
+
+        PHASE_SWITCH(PHASE_LOGBOOK);
+        group_done_us = get_time_us();
+        groups[group_id].recreated_at = get_time();
+        write_output("Unit " + to_string(group_id + 1) + " has completed document recreation phase at time " + to_string(get_time()));
+
+        groups[group_id].ready_at_us = group_done_us;
+        write_logbook_entry(group_id);
+    }
+    else
+    {
+        MUTEX_LOCK(&groups[group_id].mutex, LOCK_GROUP + group_id);
+        groups[group_id].counter++;
+        write_output("Operative " + to_string(id) + " has finished and notified group leader.");
+        if (groups[group_id].counter == M)
+        {
+            pthread_cond_broadcast(&groups[group_id].cv);
+        }
+        MUTEX_UNLOCK(&groups[group_id].mutex, LOCK_GROUP + group_id);
+        group_done_us = get_time_us();
+    }
+
+    if (timeline != NULL)
+    {
+        vector<string> events = {timeline_name(1, id, "Operative " + to_string(id)),
+                                 timeline_slice(1, id, "waiting", arrived_us, acquired_us),
+                                 timeline_slice(1, id, "typing", acquired_us, released_us),
+                                 timeline_slice(1, id, "group-wait", released_us, group_done_us),
+                                 timeline_slice(2, station_id, "Operative " + to_string(id), acquired_us, released_us)};
+        if (id == leader_id)
+            events.push_back(timeline_slice(1, id, "logging", group_done_us, groups[group_id].logged_at_us));
+        timeline_write(events);
+    }
+
+    PHASE_SWITCH(PHASE_NONE);
+    PHASE_FLUSH(); // Before a dispatched operative is counted out, so the report sees its counts
+    return NULL;
+}
+
+// Blocks until at least one commit (or shutdown) was published; returns false on shutdown
+bool wait_for_logbook_commit(long staff_id)
+{
+    uint64_t commits;
+    while (read(staff_eventfd[staff_id - 1], &commits, sizeof(commits)) != sizeof(commits))
+    {
+        if (errno != EINTR)
+            return false;
+    }
+    return simulation_running;
+}
+
+void reader_enter(int shard)
+{
+    LogbookShard &book = logbook[shard];
+    SEM_WAIT(&book.mutex, shard_lock_id(shard, false));
+    book.read_count++;
+    if (book.read_count == 1)
+    {
+        SEM_WAIT(&book.wrt, shard_lock_id(shard, true));
+    }
+    SEM_POST(&book.mutex, shard_lock_id(shard, false));
+}
+
+void reader_exit(int shard)
+{
+    LogbookShard &book = logbook[shard];
+    SEM_WAIT(&book.mutex, shard_lock_id(shard, false));
+    book.read_count--;
+    if (book.read_count == 0)
+    {
+        SEM_POST(&book.wrt, shard_lock_id(shard, true));
+    }
+    SEM_POST(&book.mutex, shard_lock_id(shard, false));
+}
+
+void review_logbook(long staff_id)
+{
+    // Reader entry protocol, on every shard in index order so that the total is a consistent snapshot
+    for (int shard = 0; shard < logbook_shard_count; shard++)
+        reader_enter(shard);
+    long long review_begin_us = get_time_us();
+
+    int current_completed = 0;
+    for (int shard = 0; shard < logbook_shard_count; shard++)
+        current_completed += logbook[shard].completed_operations;
+    write_output("Intelligence Staff " + to_string(staff_id) + " began reviewing logbook at time " + to_string(get_time()) + ". Operations completed = " + to_string(current_completed));
+    if (timeline != NULL)
+        timeline_write({timeline_slice(3, staff_id, "review (" + to_string(current_completed) + " completed)", review_begin_us, get_time_us())});
+
+    // Reader exit protocol
+    for (int shard = logbook_shard_count - 1; shard >= 0; shard--)
+        reader_exit(shard);
+}
+
+void *staff_function(void *arg)
+{
+    long staff_id = (long)arg;
+    if (staff_event_driven)
+    {
+        long reviewed = 0; // Commits published before this staff member's last review began
+        while (wait_for_logbook_commit(staff_id))
+        {
+            reviewed = __atomic_load_n(&logbook_commits_published, __ATOMIC_ACQUIRE);
+            review_logbook(staff_id);
+            __atomic_add_fetch(&staff_reviews, 1, __ATOMIC_RELAXED);
+        }
+        // Commits coalesced into the shutdown wakeup have not been reviewed yet
+        if (__atomic_load_n(&logbook_commits_published, __ATOMIC_ACQUIRE) > reviewed)
+        {
+            review_logbook(staff_id);
+            __atomic_add_fetch(&staff_reviews, 1, __ATOMIC_RELAXED);
+        }
+        return NULL;
+    }
+
+    while (simulation_running)
+    {
+        int sleep_interval = get_random_number() % (y + 2) + 1;
+        usleep(sleep_interval * 5000);
+        if (!simulation_running)
+            break;
+
+        review_logbook(staff_id);
+    }
+    return NULL;
+}
+
+struct TraceRecord
+{
+    long long arrival_us;
+    int station;
+    int typing_us;
+
+    bool operator>(const TraceRecord &other) const
+    {
+        return arrival_us > other.arrival_us;
+    }
+};
+
+// Memory-mapped workload file, parsed TRACE_CHUNK_RECORDS at a time.
+// Pages behind the parse position are dropped so the resident size stays bounded.
+class TraceReader
+{
+public:
+    TraceReader() : data(NULL), size(0), offset(0), released(0), binary(false), chunk_pos(0), raw_typing_us(0) {}
+
+    ~TraceReader()
+    {
+        if (data != NULL)
+            munmap((void *)data, size);
+    }
+
+    bool open(const char *path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+        size = st.st_size;
+        void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = (const char *)mapped;
+        madvise(mapped, size, MADV_SEQUENTIAL);
+
+        binary = size >= 8 && string(data, 8) == TRACE_MAGIC;
+        offset = binary ? 8 : 0;
+        return true;
+    }
+
+    // Number of records, counted without materializing them. A typing_us that does not fit in an int
+    // would turn negative and silently fall back to a random typing time, so such a record makes the
+    // count -1 and is described by bad_record.
+    long long count()
+    {
+        size_t start = offset;
+        long long records = 0, line = 0;
+        TraceRecord record;
+        while (offset < size)
+        {
+            line++;
+            if (!(binary ? parse_binary(record) : parse_csv(record)))
+                continue;
+            records++;
+            if (raw_typing_us > INT_MAX)
+            {
+                bad_record = (binary ? "record " + to_string(records) : "line " + to_string(line)) + ": typing_us " +
+                             to_string(raw_typing_us) + " is larger than " + to_string(INT_MAX);
+                offset = start;
+                return -1;
+            }
+        }
+        offset = start;
+        release_before(size);
+        released = 0;
+        return records;
+    }
 
-using namespace std;
+    string bad_record;
 
-int N, M, x, y;
-int G;
+    bool next(TraceRecord &record)
+    {
+        if (chunk_pos == chunk.size())
+        {
+            fill_chunk();
+            if (chunk.empty())
+                return false;
+        }
+        record = chunk[chunk_pos++];
+        return true;
+    }
 
-pthread_mutex_t station_mutex[4];
-pthread_cond_t station_cv[4];
-bool station_available[4] = {true, true, true, true};
+private:
+    const char *data;
+    size_t size;
+    size_t offset;
+    size_t released;
+    bool binary;
+    vector<TraceRecord> chunk;
+    size_t chunk_pos;
+    long long raw_typing_us; // typing_us of the last parsed record, before narrowing to int
 
-int *group_counter;
-pthread_mutex_t *group_mutex;
-pthread_cond_t *group_cv;
+    void fill_chunk()
+    {
+        chunk.clear();
+        chunk_pos = 0;
+        while (chunk.size() < TRACE_CHUNK_RECORDS && offset < size)
+        {
+            TraceRecord record;
+            if (binary ? parse_binary(record) : parse_csv(record))
+                chunk.push_back(record);
+        }
+        release_before(offset);
+    }
 
-int completed_operations = 0;
-int read_count = 0;
-sem_t wrt;   // Semaphore for writers (binary semaphore)
-sem_t mutex; // Semaphore for read_count protection
+    bool parse_binary(TraceRecord &record)
+    {
+        if (offset + 16 > size)
+        {
+            offset = size;
+            return false;
+        }
+        uint64_t arrival;
+        uint32_t station, typing;
+        memcpy(&arrival, data + offset, 8);
+        memcpy(&station, data + offset + 8, 4);
+        memcpy(&typing, data + offset + 12, 4);
+        offset += 16;
+        raw_typing_us = typing;
+        record = {(long long)arrival, (int)station, (int)typing};
+        return true;
+    }
 
-bool simulation_running = true;
+    long long parse_field()
+    {
+        long long value = 0;
+        while (offset < size && data[offset] == ' ')
+            offset++;
+        while (offset < size && data[offset] >= '0' && data[offset] <= '9')
+        {
+            int digit = data[offset++] - '0';
+            value = value > (LLONG_MAX - digit) / 10 ? LLONG_MAX : value * 10 + digit; // Saturates
+        }
+        while (offset < size && data[offset] != ',' && data[offset] != '\n')
+            offset++;
+        if (offset < size && data[offset] == ',')
+            offset++;
+        return value;
+    }
 
-pthread_mutex_t output_mutex;
-auto start_time = chrono::high_resolution_clock::now();
+    bool parse_csv(TraceRecord &record)
+    {
+        bool is_record = data[offset] >= '0' && data[offset] <= '9';
+        if (is_record)
+        {
+            record.arrival_us = parse_field();
+            record.station = (int)parse_field();
+            raw_typing_us = parse_field();
+            record.typing_us = (int)raw_typing_us;
+        }
+        const char *line_end = (const char *)memchr(data + offset, '\n', size - offset);
+        offset = line_end == NULL ? size : line_end - data + 1;
+        return is_record;
+    }
 
-long long get_time()
+    void release_before(size_t limit)
+    {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t end = limit / page * page;
+        if (end > released)
+        {
+            madvise((void *)(data + released), end - released, MADV_DONTNEED);
+            released = end;
+        }
+    }
+};
+
+void *dispatched_operative_function(void *arg)
 {
-    auto end_time = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
-    long long elapsed_time_ms = duration.count();
-    return elapsed_time_ms;
+    operative_function(arg);
+    operative_arena.release((Operative *)arg);
+#ifdef LOCK_PROFILE
+    lock_stats_buffer.flush();
+#endif
+
+    pthread_mutex_lock(&in_flight_mutex);
+    operatives_in_flight--;
+    if (operatives_in_flight == 0)
+        pthread_cond_signal(&in_flight_cv);
+    pthread_mutex_unlock(&in_flight_mutex);
+    return NULL;
 }
 
-void write_output(string message)
+// Station 0 means the default ID % 4 + 1; typing_us -1 draws the typing time at the station
+void spawn_dispatched_operative(long id, int station, int typing_us)
 {
-    pthread_mutex_lock(&output_mutex);
-    cout << message << endl;
-    pthread_mutex_unlock(&output_mutex);
+    Operative *op = operative_arena.allocate();
+    op->id = id;
+    op->station_id = station >= 1 && station <= 4 ? station : (id % 4) + 1;
+    op->dispatched = true;
+    op->typing_us = typing_us;
+
+    pthread_mutex_lock(&in_flight_mutex);
+    operatives_in_flight++;
+    operatives_in_flight_peak = max(operatives_in_flight_peak, operatives_in_flight);
+    pthread_mutex_unlock(&in_flight_mutex);
+
+    pthread_attr_t attr;
+    init_operative_attr(&attr, true);
+    pthread_t thread;
+    create_operative_thread(&thread, &attr, dispatched_operative_function, op);
+    pthread_attr_destroy(&attr);
 }
 
-int get_random_number()
+void wait_for_dispatched_operatives()
 {
-    random_device rd;
-    mt19937 generator(rd());
-
-    // Lambda value for the Poisson distribution
-    double lambda = 10000.234;
-    poisson_distribution<int> poissonDist(lambda);
-    return poissonDist(generator);
+    pthread_mutex_lock(&in_flight_mutex);
+    while (operatives_in_flight > 0)
+        pthread_cond_wait(&in_flight_cv, &in_flight_mutex);
+    pthread_mutex_unlock(&in_flight_mutex);
 }
 
-void *operative_function(void *arg)
+// Feeds operatives to the simulation in arrival order, sleeping until each arrival time
+void dispatch_trace(TraceReader &reader)
 {
-    long id = (long)arg;
-    int delay_arrival = get_random_number() % (x + 2) + 1;
-    usleep(delay_arrival * 5000);
-    int station_id = (id % 4) + 1;
-    int station_index = station_id - 1;
-    write_output("Operative " + to_string(id) + " has arrived at typewriting station " + to_string(station_id) + " at time " + to_string(get_time()));
-    write_output("Operative " + to_string(id) + " is requesting station " + to_string(station_id) + ".");
+    priority_queue<TraceRecord, vector<TraceRecord>, greater<TraceRecord>> window;
+    TraceRecord record;
+    bool more = true;
+    long next_id = 1;
+    long long late_records = 0;
+    long long last_arrival = 0;
 
-    pthread_mutex_lock(&station_mutex[station_index]);
-    while (!station_available[station_index])
+    while (more || !window.empty())
     {
-        write_output("Operative " + to_string(id) + " is waiting for station " + to_string(station_id) + ".");
-        pthread_cond_wait(&station_cv[station_index], &station_mutex[station_index]);
+        while (more && window.size() < TRACE_REORDER_WINDOW)
+        {
+            more = reader.next(record);
+            if (more)
+                window.push(record);
+        }
+        if (window.empty())
+            break;
+
+        record = window.top();
+        window.pop();
+        if (record.arrival_us < last_arrival)
+            late_records++;
+        last_arrival = max(last_arrival, record.arrival_us);
+
+        long long wait_us = record.arrival_us - get_time_us();
+        if (wait_us > 0)
+            usleep(wait_us);
+        spawn_dispatched_operative(next_id++, record.station, record.typing_us);
     }
-    station_available[station_index] = false;
-    pthread_mutex_unlock(&station_mutex[station_index]);
-    write_output("Operative " + to_string(id) + " has acquired station " + to_string(station_id) + ".");
 
-    int typewriting_time = get_random_number() % (y + 2) + 1;
-    usleep(typewriting_time * 5000);
-    write_output("Operative " + to_string(id) + " has completed document recreation at station " + to_string(station_id) + " at time " + to_string(get_time()));
+    wait_for_dispatched_operatives();
 
-    pthread_mutex_lock(&station_mutex[station_index]);
-    station_available[station_index] = true;
-    pthread_cond_broadcast(&station_cv[station_index]);
-    pthread_mutex_unlock(&station_mutex[station_index]);
-    write_output("Operative " + to_string(id) + " has released station " + to_string(station_id) + ".");
+    if (late_records > 0)
+        cerr << "Warning: " << late_records << " trace records were out of order beyond the reorder window" << endl;
+}
 
-    int group_id = (id - 1) / M;
-    int leader_id = (group_id + 1) * M;
+// Open-system load generator: Poisson arrivals at open_rate for open_duration seconds
+void dispatch_open_system()
+{
+    mt19937 generator(random_device{}());
+    exponential_distribution<double> interarrival(open_rate);
+    long long end_us = (long long)(open_duration * 1e6);
+    long long warmup_us = (long long)(open_warmup * 1e6);
+    long long arrival_us = 0;
+    long next_id = 1;
 
-    if (id == leader_id)
+    while (true)
     {
-        write_output("Leader Operative " + to_string(id) + " is waiting for group members to finish.");
-        pthread_mutex_lock(&group_mutex[group_id]);
-        group_counter[group_id]++;
-        if (group_counter[group_id] < M)
+        arrival_us += (long long)(interarrival(generator) * 1e6);
+        if (arrival_us >= end_us)
+            break;
+        if (next_id > N)
+        {
+            cerr << "Warning: open system stopped after " << N << " arrivals (capacity reached)" << endl;
+            break;
+        }
+        long long wait_us = arrival_us - get_time_us();
+        if (wait_us > 0)
+            usleep(wait_us);
+
+        // Poisson arrivals see time averages, so sampling here estimates the mean queue lengths
+        if (arrival_us >= warmup_us)
         {
-            while (group_counter[group_id] < M)
+            for (int i = 0; i < 4; i++)
             {
-                pthread_cond_wait(&group_cv[group_id], &group_mutex[group_id]);
+                pthread_mutex_lock(&station_mutex[i]);
+                open_station_samples[i] += station_waiting[i];
+                pthread_mutex_unlock(&station_mutex[i]);
             }
+            open_logbook_samples += __atomic_load_n(&logbook_waiting, __ATOMIC_RELAXED);
+            open_samples++;
         }
-        pthread_mutex_unlock(&group_mutex[group_id]);
-        write_output("Leader Operative " + to_string(id) + " detected all group members finished.");
+        open_arrival_us[next_id] = get_time_us();
+        spawn_dispatched_operative(next_id++, 0, -1);
+    }
+    open_arrivals = next_id - 1;
+    wait_for_dispatched_operatives();
+}
 
-        write_output("Unit " + to_string(group_id + 1) + " has completed document recreation phase at time " + to_string(get_time()));
+void open_system_report()
+{
+    long long end_us = (long long)(open_duration * 1e6);
+    long long warmup_us = (long long)(open_warmup * 1e6);
+
+    // Latency of every measured operative whose unit reached the logbook
+    vector<long long> latencies;
+    long long logged_in_window = 0;
+    for (long id = 1; id <= open_arrivals; id++)
+    {
+        GroupState &group = groups[(id - 1) / M];
+        if (group.logged_at < 0)
+            continue;
+        if (open_arrival_us[id] >= warmup_us)
+            latencies.push_back(group.logged_at_us - open_arrival_us[id]);
+        if (id % M == 0 && group.logged_at_us >= warmup_us && group.logged_at_us < end_us)
+            logged_in_window++;
+    }
+    sort(latencies.begin(), latencies.end());
+    double window_s = open_duration - open_warmup;
+
+    cout << "Open system: " << open_rate << " operatives/s for " << open_duration << " s, warm-up " << open_warmup << " s" << endl;
+    cout << "Arrivals: " << open_arrivals << " (" << latencies.size() << " measured and logged)" << endl;
+    cout << "Throughput: " << logged_in_window / window_s << " units/s, " << logged_in_window * M / window_s << " operatives/s" << endl;
+    if (open_samples > 0)
+    {
+        cout << "Mean queue length: stations";
+        for (int i = 0; i < 4; i++)
+            cout << " " << open_station_samples[i] / open_samples;
+        cout << ", logbook writers " << open_logbook_samples / open_samples << endl;
+    }
+    if (!latencies.empty())
+    {
+        auto percentile = [&](double p)
+        { return latencies[min(latencies.size() - 1, (size_t)(p * latencies.size()))] / 1000.0; };
+        cout << "Arrival-to-logbook latency (ms): p50 " << percentile(0.50) << ", p90 " << percentile(0.90)
+             << ", p99 " << percentile(0.99) << ", max " << latencies.back() / 1000.0 << endl;
+    }
+}
+
+// Result of one run of the virtual-time model; times in us
+struct VirtualResult
+{
+    long arrivals = 0;
+    long long makespan = 0;
+    vector<long long> latencies;     // Arrival to logbook, operatives arriving after the warm-up
+    vector<long long> station_waits; // Arrival to station acquire, same operatives
+    vector<long long> logged_times;  // Logbook entry times of all units, in order
+    double station_utilization[4] = {0};
+    double logbook_utilization = 0; // Busiest shard
+};
+
+// Discrete-event model of the operative lifecycle in virtual time. rate > 0 runs the open system
+// for duration_s seconds; otherwise the closed batch of N operatives with the usual arrival delays.
+// The draws mirror the threaded simulation: (Poisson % (k + 2) + 1) * 5 ms.
+VirtualResult run_virtual(double rate, double duration_s, double warmup_s, unsigned seed)
+{
+    enum
+    {
+        V_ARRIVE,
+        V_TYPED,
+        V_LOGGED
+    };
+    struct VirtualEvent
+    {
+        long long time;
+        long seq;
+        int type;
+        long subject;
+        bool operator>(const VirtualEvent &other) const
+        {
+            return time != other.time ? time > other.time : seq > other.seq;
+        }
+    };
+
+    mt19937 generator(seed);
+    poisson_distribution<int> poisson(10000.234);
+    exponential_distribution<double> interarrival(rate > 0 ? rate : 1.0);
+    auto draw = [&](int k)
+    { return (long long)(poisson(generator) % (k + 2) + 1) * 5000; };
+
+    priority_queue<VirtualEvent, vector<VirtualEvent>, greater<VirtualEvent>> agenda;
+    long seq = 0;
+    long long end_us = (long long)(duration_s * 1e6);
+    long long warmup_us = (long long)(warmup_s * 1e6);
+
+    VirtualResult result;
+    vector<long long> arrival;
+    vector<int> unit_done;
+    bool station_busy[4] = {false, false, false, false};
+    long long station_since[4] = {0}, station_busy_us[4] = {0};
+    vector<long> station_queue_v[4];
+    vector<bool> logbook_busy(logbook_shard_count, false);
+    vector<long long> logbook_since(logbook_shard_count, 0), logbook_busy_us(logbook_shard_count, 0);
+    vector<queue<long>> logbook_queue(logbook_shard_count);
+
+    auto ensure = [&](long id)
+    {
+        if ((long)arrival.size() <= id)
+            arrival.resize(id * 2 + 1, -1);
+        if ((long)unit_done.size() <= (id - 1) / M)
+            unit_done.resize((id - 1) / M * 2 + 1, 0);
+    };
+    // Busy time counts only inside the measurement window
+    auto window_overlap = [&](long long from, long long to)
+    { return max(0LL, min(to, rate > 0 ? end_us : to) - max(from, warmup_us)); };
+
+    auto start_typing = [&](long id, long long now)
+    {
+        int s = id % 4;
+        station_busy[s] = true;
+        station_since[s] = now;
+        if (arrival[id] >= warmup_us)
+            result.station_waits.push_back(now - arrival[id]);
+        agenda.push({now + draw(y), seq++, V_TYPED, id});
+    };
+    auto start_logging = [&](long unit, long long now)
+    {
+        logbook_busy[unit % logbook_shard_count] = true;
+        logbook_since[unit % logbook_shard_count] = now;
+        agenda.push({now + draw(y), seq++, V_LOGGED, unit});
+    };
 
-        // Writer entry protocol
-        sem_wait(&wrt);
-        int writing_time = get_random_number() % (y + 2) + 1;
-        usleep(writing_time * 5000);
-        completed_operations++;
-        write_output("Unit " + to_string(group_id + 1) + " has completed intelligence distribution at time " + to_string(get_time()));
-        sem_post(&wrt);
+    if (rate > 0)
+    {
+        long long t = (long long)(interarrival(generator) * 1e6);
+        for (long id = 1; t < end_us; id++)
+        {
+            agenda.push({t, seq++, V_ARRIVE, id});
+            t += (long long)(interarrival(generator) * 1e6);
+        }
     }
     else
     {
-        pthread_mutex_lock(&group_mutex[group_id]);
-        group_counter[group_id]++;
-        write_output("Operative " + to_string(id) + " has finished and notified group leader.");
-        if (group_counter[group_id] == M)
+        for (long id = 1; id <= N; id++)
+            agenda.push({draw(x), seq++, V_ARRIVE, id});
+    }
+
+    while (!agenda.empty())
+    {
+        VirtualEvent event = agenda.top();
+        agenda.pop();
+        long long now = event.time;
+        if (event.type == V_ARRIVE)
+        {
+            long id = event.subject;
+            ensure(id);
+            arrival[id] = now;
+            result.arrivals++;
+            int s = id % 4;
+            if (station_busy[s])
+                station_queue_v[s].push_back(id);
+            else
+                start_typing(id, now);
+        }
+        else if (event.type == V_TYPED)
+        {
+            long id = event.subject;
+            int s = id % 4;
+            station_busy_us[s] += window_overlap(station_since[s], now);
+            station_busy[s] = false;
+
+            vector<long> &waiting = station_queue_v[s];
+            if (!waiting.empty())
+            {
+                size_t next = 0;
+                for (size_t i = 1; i < waiting.size(); i++)
+                {
+                    long a = waiting[i], b = waiting[next];
+                    bool better = false;
+                    if (station_policy == POLICY_BROADCAST)
+                        better = generator() % (i + 1) == 0; // Any waiter may win the wakeup race
+                    else if (station_policy == POLICY_LEADER_FIRST && (a % M == 0) != (b % M == 0))
+                        better = a % M == 0;
+                    else if (station_policy == POLICY_UNIT_FIRST && unit_done[(a - 1) / M] != unit_done[(b - 1) / M])
+                        better = unit_done[(a - 1) / M] > unit_done[(b - 1) / M];
+                    if (better)
+                        next = i;
+                }
+                long chosen = waiting[next];
+                waiting.erase(waiting.begin() + next);
+                start_typing(chosen, now);
+            }
+
+            long unit = (id - 1) / M;
+            if (++unit_done[unit] == M)
+            {
+                if (logbook_busy[unit % logbook_shard_count])
+                    logbook_queue[unit % logbook_shard_count].push(unit);
+                else
+                    start_logging(unit, now);
+            }
+        }
+        else
         {
-            pthread_cond_broadcast(&group_cv[group_id]);
+            long unit = event.subject;
+            int shard = unit % logbook_shard_count;
+            logbook_busy_us[shard] += window_overlap(logbook_since[shard], now);
+            logbook_busy[shard] = false;
+            result.logged_times.push_back(now);
+            result.makespan = now;
+            for (long id = unit * M + 1; id <= (unit + 1) * M; id++)
+                if (arrival[id] >= warmup_us && (rate <= 0 || arrival[id] < end_us))
+                    result.latencies.push_back(now - arrival[id]);
+            if (!logbook_queue[shard].empty())
+            {
+                start_logging(logbook_queue[shard].front(), now);
+                logbook_queue[shard].pop();
+            }
         }
-        pthread_mutex_unlock(&group_mutex[group_id]);
     }
 
-    return NULL;
+    long long window = (rate > 0 ? end_us : result.makespan) - warmup_us;
+    for (int i = 0; i < 4; i++)
+        result.station_utilization[i] = window > 0 ? (double)station_busy_us[i] / window : 0;
+    for (int i = 0; i < logbook_shard_count; i++)
+        result.logbook_utilization = max(result.logbook_utilization, window > 0 ? (double)logbook_busy_us[i] / window : 0);
+    return result;
 }
 
-void *staff_function(void *arg)
+long long percentile_of(vector<long long> values, double p)
 {
-    long staff_id = (long)arg;
-    while (simulation_running)
+    if (values.empty())
+        return 0;
+    sort(values.begin(), values.end());
+    return values[min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+double capacity_slo_ms = 0;
+double capacity_duration = 600;
+
+// Binary search for the highest arrival rate whose p99 latency meets the SLO
+void capacity_search(ostream &out)
+{
+    unsigned seed = random_device()();
+    double warmup = capacity_duration * 0.2;
+    auto p99_ms = [&](double rate, VirtualResult &result)
     {
-        int sleep_interval = get_random_number() % (y + 2) + 1;
-        usleep(sleep_interval * 5000);
-        if (!simulation_running)
-            break;
+        result = run_virtual(rate, capacity_duration, warmup, seed);
+        return percentile_of(result.latencies, 0.99) / 1000.0;
+    };
 
-        // Reader entry protocol
-        sem_wait(&mutex);
-        read_count++;
-        if (read_count == 1)
+    out << "Capacity search: p99 arrival-to-logbook SLO " << capacity_slo_ms << " ms, "
+        << capacity_duration << " s virtual per probe" << endl;
+
+    // Latency is not monotonic at the low end: a sparse stream leaves units waiting for their
+    // last members. Climb to the first rate that meets the SLO, then bracket its upper edge.
+    VirtualResult result;
+    double low = 1;
+    while (true)
+    {
+        double p99 = p99_ms(low, result);
+        out << "  rate " << low << "/s: p99 " << p99 << " ms" << endl;
+        if (p99 <= capacity_slo_ms && !result.latencies.empty())
+            break;
+        low *= 2;
+        if (low > 1e6)
+        {
+            out << "SLO cannot be met at any arrival rate" << endl;
+            return;
+        }
+    }
+    double high = low * 2;
+    while (true)
+    {
+        double p99 = p99_ms(high, result);
+        out << "  rate " << high << "/s: p99 " << p99 << " ms" << endl;
+        if (p99 > capacity_slo_ms)
+            break;
+        low = high;
+        high *= 2;
+        if (high > 1e6)
         {
-            sem_wait(&wrt);
+            out << "SLO is met at every rate tried" << endl;
+            return;
         }
-        sem_post(&mutex);
+    }
+    while (high - low > low * 0.005)
+    {
+        double middle = (low + high) / 2;
+        double p99 = p99_ms(middle, result);
+        out << "  rate " << middle << "/s: p99 " << p99 << " ms" << endl;
+        if (p99 <= capacity_slo_ms)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    double p99 = p99_ms(low, result);
+    out << "Saturation: " << low << " operatives/s (p99 " << p99 << " ms)" << endl;
+    int busiest = 0;
+    for (int i = 1; i < 4; i++)
+        if (result.station_utilization[i] > result.station_utilization[busiest])
+            busiest = i;
+    out << "Utilization at saturation: stations";
+    for (int i = 0; i < 4; i++)
+        out << " " << (int)(result.station_utilization[i] * 100) << "%";
+    out << ", logbook " << (int)(result.logbook_utilization * 100) << "%" << endl;
+    if (result.logbook_utilization >= result.station_utilization[busiest])
+        out << "Bottleneck: logbook" << endl;
+    else
+        out << "Bottleneck: station " << busiest + 1 << endl;
+}
+
+int replicate_count = 0;
+
+// Per-replica summary; one row per replica, filled by whichever worker ran it
+struct ReplicaSummary
+{
+    double makespan_ms;
+    double wait_ms[3]; // p50, p95, p99 of the station wait
+    vector<long long> logged_times;
+};
+
+vector<ReplicaSummary> replicas;
+unsigned replica_seed_base;
+int next_replica = 0;
+
+void *replica_worker(void *)
+{
+    while (true)
+    {
+        int r = __atomic_fetch_add(&next_replica, 1, __ATOMIC_RELAXED);
+        if (r >= replicate_count)
+            return NULL;
+        seed_seq seeds{replica_seed_base, (unsigned)r};
+        unsigned seed;
+        seeds.generate(&seed, &seed + 1);
+
+        VirtualResult result = run_virtual(0, 0, 0, seed);
+        ReplicaSummary &summary = replicas[r];
+        summary.makespan_ms = result.makespan / 1000.0;
+        summary.wait_ms[0] = percentile_of(result.station_waits, 0.50) / 1000.0;
+        summary.wait_ms[1] = percentile_of(result.station_waits, 0.95) / 1000.0;
+        summary.wait_ms[2] = percentile_of(result.station_waits, 0.99) / 1000.0;
+        summary.logged_times.swap(result.logged_times); // Already in time order
+    }
+}
+
+// Two-sided 95% Student t quantile for the given degrees of freedom
+double t_quantile_95(int df)
+{
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df < 1)
+        return 0;
+    if (df <= 30)
+        return table[df - 1];
+    return df <= 60 ? 2.000 : df <= 120 ? 1.980
+                                        : 1.960;
+}
+
+void print_interval(ostream &out, const string &label, const vector<double> &values)
+{
+    double mean = 0, variance = 0;
+    for (double v : values)
+        mean += v;
+    mean /= values.size();
+    for (double v : values)
+        variance += (v - mean) * (v - mean);
+    double stddev = values.size() > 1 ? sqrt(variance / (values.size() - 1)) : 0;
+    double half = t_quantile_95(values.size() - 1) * stddev / sqrt((double)values.size());
+    out << label << "\t" << mean << "\t" << stddev << "\t[" << mean - half << ", " << mean + half << "]" << endl;
+}
+
+void replicate(ostream &out)
+{
+    replicas.assign(replicate_count, ReplicaSummary());
+    replica_seed_base = random_device()();
+    long workers = max(1L, min((long)replicate_count, sysconf(_SC_NPROCESSORS_ONLN)));
 
-        int current_completed = completed_operations;
-        write_output("Intelligence Staff " + to_string(staff_id) + " began reviewing logbook at time " + to_string(get_time()) + ". Operations completed = " + to_string(current_completed));
+    auto begin = chrono::steady_clock::now();
+    vector<pthread_t> threads(workers);
+    for (long i = 0; i < workers; i++)
+        pthread_create(&threads[i], NULL, replica_worker, NULL);
+    for (long i = 0; i < workers; i++)
+        pthread_join(threads[i], NULL);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
 
-        // Reader exit protocol
-        sem_wait(&mutex);
-        read_count--;
-        if (read_count == 0)
+    out << replicate_count << " replicas of N=" << N << " M=" << M << " on " << workers
+        << " threads in " << elapsed << " s" << endl;
+    out << "metric\tmean\tstddev\t95% CI" << endl;
+
+    vector<double> values(replicate_count);
+    for (int r = 0; r < replicate_count; r++)
+        values[r] = replicas[r].makespan_ms;
+    print_interval(out, "makespan_ms", values);
+    double mean_makespan_us = 0;
+    for (double v : values)
+        mean_makespan_us += v * 1000 / replicate_count;
+
+    for (int k = 1; k <= 10; k++)
+    {
+        long long at = (long long)(mean_makespan_us * k / 10);
+        for (int r = 0; r < replicate_count; r++)
         {
-            sem_post(&wrt);
+            const vector<long long> &logged = replicas[r].logged_times;
+            values[r] = upper_bound(logged.begin(), logged.end(), at) - logged.begin();
         }
-        sem_post(&mutex);
+        print_interval(out, "completed@" + to_string(k * 10) + "%", values);
+    }
+
+    const char *wait_labels[] = {"wait_p50_ms", "wait_p95_ms", "wait_p99_ms"};
+    for (int q = 0; q < 3; q++)
+    {
+        for (int r = 0; r < replicate_count; r++)
+            values[r] = replicas[r].wait_ms[q];
+        print_interval(out, wait_labels[q], values);
     }
-    return NULL;
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    const char *trace_path = NULL;
+    const char *timeline_path = NULL;
+    for (int i = 3; i < argc; i++)
+    {
+        string option = argv[i];
+        if (option.rfind("--trace=", 0) == 0)
+            trace_path = argv[i] + 8;
+        else if (option.rfind("--stack-kb=", 0) == 0)
+            operative_stack_size = max((size_t)PTHREAD_STACK_MIN, (size_t)atol(argv[i] + 11) * 1024);
+        else if (option == "--policy=broadcast" || option == "--policy=fifo" || option == "--policy=leader" || option == "--policy=unit")
+        {
+            string policy = option.substr(9);
+            station_policy = policy == "fifo" ? POLICY_FIFO : policy == "leader" ? POLICY_LEADER_FIRST
+                                                          : policy == "unit"     ? POLICY_UNIT_FIRST
+                                                                                 : POLICY_BROADCAST;
+            report_schedule = true;
+        }
+        else if (option.rfind("--capacity=", 0) == 0)
+        {
+            if (sscanf(argv[i] + 11, "%lf,%lf", &capacity_slo_ms, &capacity_duration) < 1 || capacity_slo_ms <= 0 || capacity_duration <= 0)
+                argc = 0;
+        }
+        else if (option.rfind("--shards=", 0) == 0)
+        {
+            logbook_shard_count = atoi(argv[i] + 9);
+            report_logbook = true;
+            if (logbook_shard_count <= 0)
+                argc = 0;
+        }
+        else if (option == "--combine")
+        {
+            logbook_combining = true;
+            report_logbook = true;
+        }
+        else if (option.rfind("--log-cost=", 0) == 0)
+        {
+            double batch_ms = 0, entry_ms = 0;
+            if (sscanf(argv[i] + 11, "%lf,%lf", &batch_ms, &entry_ms) != 2 || batch_ms < 0 || entry_ms < 0)
+                argc = 0;
+            else
+            {
+                log_batch_us = (long long)(batch_ms * 1000);
+                log_entry_us = (long long)(entry_ms * 1000);
+                report_logbook = true;
+            }
+        }
+        else if (option == "--stamp=us" || option == "--stamp=ns")
+        {
+            stamp_divisor = option == "--stamp=us" ? 1000 : 1;
+            stamp_unit = option == "--stamp=us" ? "us" : "ns";
+        }
+        else if (option.rfind("--timeline=", 0) == 0)
+            timeline_path = argv[i] + 11;
+        else if (option == "--staff=poll" || option == "--staff=event")
+            staff_event_driven = option == "--staff=event";
+        else if (option.rfind("--replicate=", 0) == 0)
+        {
+            replicate_count = atoi(argv[i] + 12);
+            if (replicate_count <= 0)
+                argc = 0;
+        }
+        else if (option.rfind("--open=", 0) == 0)
+        {
+            if (sscanf(argv[i] + 7, "%lf,%lf,%lf", &open_rate, &open_duration, &open_warmup) < 2 || open_rate <= 0 || open_duration <= 0)
+                argc = 0;
+        }
+        else
+            argc = 0; // Unknown option, fall through to the usage message
+    }
+    if (argc < 3)
+    {
+        cout << "Usage: ./Shadows_of_Small_Health.cpp.out <input_file> <output_file> [--trace=<workload_file>] [--stack-kb=<size>]"
+             << " [--policy=<broadcast|fifo|leader|unit>] [--open=<rate>,<duration_s>[,<warmup_s>]]"
+             << " [--capacity=<slo_ms>[,<virtual_duration_s>]] [--replicate=<K>]"
+             << " [--staff=<poll|event>] [--timeline=<json_file>]"
+             << " [--shards=<K>] [--combine] [--log-cost=<batch_ms>,<entry_ms>]"
+             << " [--stamp=<us|ns>]" << endl;
+        return 0;
+    }
+#ifdef PHASE_COUNTERS
+    phase_counter_init();
+#endif
+
+    TraceReader trace;
+    long long trace_records = 0;
+    if (trace_path != NULL && !trace.open(trace_path))
+    {
+        cout << "Cannot open workload file " << trace_path << endl;
+        return 0;
+    }
+    if (trace_path != NULL && (trace_records = trace.count()) < 0)
+    {
+        cout << "Invalid workload file " << trace_path << ", " << trace.bad_record << endl;
+        return 0;
+    }
+    if (timeline_path != NULL && !timeline_open(timeline_path))
     {
-        cout << "Usage: ./Shadows_of_Small_Health.cpp.out <input_file> <output_file>" << endl;
+        cout << "Cannot create timeline file " << timeline_path << endl;
         return 0;
     }
 
@@ -225,13 +2179,51 @@ int main(int argc, char *argv[])
     cout.rdbuf(outputFile.rdbuf());
 
     cin >> N >> M >> x >> y;
-    G = N / M;
+    if (trace_path != NULL)
+        N = trace_records;
+    if (open_rate > 0)
+    {
+        // Enough room for any plausible Poisson count; the generator stops if it is ever exceeded
+        double expected = open_rate * open_duration;
+        N = (int)(expected + 10 * sqrt(expected) + 10 * M);
+        if (open_warmup < 0 || open_warmup >= open_duration)
+            open_warmup = open_duration * 0.2;
+        open_arrival_us.assign(N + 1, 0);
+    }
+    G = (N + M - 1) / M; // A trailing partial unit has no leader and is never logged
+
+    if (capacity_slo_ms > 0 || replicate_count > 0)
+    {
+        ostream console(coutBuffer);
+        if (capacity_slo_ms > 0)
+            capacity_search(console);
+        else
+            replicate(console);
+        cin.rdbuf(cinBuffer);
+        cout.rdbuf(coutBuffer);
+        return 0;
+    }
+    lean_rng_seed = random_device()();
+
+#ifdef LOCK_PROFILE
+    lock_profile_init(G, logbook_shard_count);
+#endif
 
     start_time = chrono::high_resolution_clock::now();
+    clock_gettime(CLOCK_MONOTONIC_RAW, &stamp_start);
 
     // Initialize semaphores
-    sem_init(&wrt, 0, 1);   // Binary semaphore for writers
-    sem_init(&mutex, 0, 1); // Binary semaphore for read_count
+    logbook = new LogbookShard[logbook_shard_count];
+    for (int i = 0; i < logbook_shard_count; i++)
+    {
+        sem_init(&logbook[i].wrt, 0, 1);   // Binary semaphore for writers
+        sem_init(&logbook[i].mutex, 0, 1); // Binary semaphore for read_count
+        logbook[i].read_count = 0;
+        logbook[i].completed_operations = 0;
+        logbook[i].writer_wait_us = 0;
+        logbook[i].batches = 0;
+        logbook[i].pending = NULL;
+    }
 
     for (int i = 0; i < 4; i++)
     {
@@ -239,21 +2231,33 @@ int main(int argc, char *argv[])
         pthread_cond_init(&station_cv[i], NULL);
     }
 
-    group_counter = new int[G]();
-    group_mutex = new pthread_mutex_t[G];
-    group_cv = new pthread_cond_t[G];
+    groups = new GroupState[G];
     for (int i = 0; i < G; i++)
     {
-        pthread_mutex_init(&group_mutex[i], NULL);
-        pthread_cond_init(&group_cv[i], NULL);
+        groups[i].counter = 0;
+        groups[i].recreated_at = -1;
+        groups[i].logged_at = -1;
+        groups[i].logged_at_us = -1;
+        groups[i].ready_at_us = -1;
+        pthread_mutex_init(&groups[i].mutex, NULL);
+        pthread_cond_init(&groups[i].cv, NULL);
     }
 
     pthread_mutex_init(&output_mutex, NULL);
+    pthread_mutex_init(&in_flight_mutex, NULL);
+    pthread_cond_init(&in_flight_cv, NULL);
 
-    pthread_t op_threads[N];
-    for (long i = 0; i < N; i++)
+    if (staff_event_driven)
     {
-        pthread_create(&op_threads[i], NULL, operative_function, (void *)(i + 1));
+        for (int i = 0; i < 2; i++)
+        {
+            staff_eventfd[i] = eventfd(0, EFD_CLOEXEC);
+            if (staff_eventfd[i] < 0)
+            {
+                perror("eventfd");
+                staff_event_driven = false;
+            }
+        }
     }
 
     pthread_t staff_threads[2];
@@ -262,17 +2266,69 @@ int main(int argc, char *argv[])
         pthread_create(&staff_threads[i], NULL, staff_function, (void *)(i + 1));
     }
 
-    for (int i = 0; i < N; i++)
+    long baseline_kb = resident_kb();
+    if (open_rate > 0)
+    {
+        dispatch_open_system();
+    }
+    else if (trace_path != NULL)
     {
-        pthread_join(op_threads[i], NULL);
+        dispatch_trace(trace);
+        if (operative_stack_size > 0 && operatives_in_flight_peak > 0)
+        {
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            cerr << "Memory: peak RSS " << usage.ru_maxrss / 1024 << " MB with at most " << operatives_in_flight_peak
+                 << " operatives in flight, " << (usage.ru_maxrss - baseline_kb) / operatives_in_flight_peak << " KB per operative" << endl;
+        }
+    }
+    else
+    {
+        vector<Operative *> operatives(N);
+        vector<pthread_t> op_threads(N);
+        pthread_attr_t attr;
+        init_operative_attr(&attr, false);
+        for (long i = 0; i < N; i++)
+        {
+            operatives[i] = operative_arena.allocate();
+            *operatives[i] = {i + 1, (int)((i + 1) % 4) + 1, false, -1};
+            create_operative_thread(&op_threads[i], &attr, operative_function, operatives[i]);
+        }
+        pthread_attr_destroy(&attr);
+
+        if (operative_stack_size > 0 && N > 0)
+        {
+            long spawned_kb = resident_kb();
+            cerr << "Memory: RSS " << baseline_kb / 1024 << " MB before and " << spawned_kb / 1024 << " MB after starting "
+                 << N << " operatives, " << (spawned_kb - baseline_kb) / N << " KB per operative" << endl;
+        }
+
+        for (int i = 0; i < N; i++)
+        {
+            pthread_join(op_threads[i], NULL);
+        }
     }
 
     simulation_running = false;
+    if (staff_event_driven)
+        publish_logbook_commit(); // Wakes idle staff so they see the shutdown
 
     for (int i = 0; i < 2; i++)
     {
         pthread_join(staff_threads[i], NULL);
     }
+    if (timeline != NULL)
+        timeline_close();
+    if (staff_event_driven)
+    {
+        cerr << "Staff notifications: " << logbook_commits_published << " logbook commits published, "
+             << staff_reviews << " reviews" << endl;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        if (staff_eventfd[i] >= 0)
+            close(staff_eventfd[i]);
+    }
 
     for (int i = 0; i < 4; i++)
     {
@@ -282,20 +2338,38 @@ int main(int argc, char *argv[])
 
     for (int i = 0; i < G; i++)
     {
-        pthread_mutex_destroy(&group_mutex[i]);
-        pthread_cond_destroy(&group_cv[i]);
+        pthread_mutex_destroy(&groups[i].mutex);
+        pthread_cond_destroy(&groups[i].cv);
     }
 
-    sem_destroy(&wrt);
-    sem_destroy(&mutex);
+    for (int i = 0; i < logbook_shard_count; i++)
+    {
+        sem_destroy(&logbook[i].wrt);
+        sem_destroy(&logbook[i].mutex);
+    }
     pthread_mutex_destroy(&output_mutex);
-
-    delete[] group_counter;
-    delete[] group_mutex;
-    delete[] group_cv;
+    pthread_mutex_destroy(&in_flight_mutex);
+    pthread_cond_destroy(&in_flight_cv);
 
     cin.rdbuf(cinBuffer);
     cout.rdbuf(coutBuffer);
 
+    if (open_rate > 0)
+        open_system_report();
+    if (report_schedule)
+        schedule_report();
+    if (report_logbook)
+        logbook_report();
+
+    delete[] groups;
+    delete[] logbook;
+
+#ifdef LOCK_PROFILE
+    lock_profile_report();
+#endif
+#ifdef PHASE_COUNTERS
+    phase_counter_report();
+#endif
+
     return 0;
 }
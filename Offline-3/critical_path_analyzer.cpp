@@ -0,0 +1,420 @@
+/*
+  This program rebuilds the happens-before graph of a Shadows_of_Small_Health.cpp run from its output
+  log and reports the critical path of the whole run, i.e. the chain of dependent events that ends at
+  the last logbook entry, with the makespan attributed to the kind of work along that chain.
+
+  Key points:
+    - Every log line becomes an event; lines without a timestamp take the latest timestamp seen so far,
+      which is exact up to the logging granularity because lines are written under output_mutex.
+    - Edges: program order within an operative, station release -> next acquire of the same station
+      (the k-th release enables the (k+1)-th acquire), member finish -> leader wakeup, and writer exit
+      -> next reader or writer entry on the logbook.
+    - The path is traced backwards from the last logbook entry, always following the predecessor that
+      finished last, and each step is charged to one of: arrival, station queueing, typing, group
+      waiting, logbook. The log has no writer-entry line, so logbook time includes the writing itself.
+    - Lines stamped by the simulation's --stamp option ("#<seq> <time>us|ns ...") are timed by the
+      stamp instead of the millisecond "at time" value, which gives exact order and sub-millisecond
+      resolution; times are kept in microseconds either way.
+    - The file is memory-mapped and parsed without iostreams, so a 10M-event trace takes seconds.
+
+  Compilation:
+    g++ -O2 critical_path_analyzer.cpp -o critical_path_analyzer.out
+
+  Usage:
+    ./critical_path_analyzer.out <output_file> [--path]
+
+    --path also prints every event on the critical path.
+
+  Output:
+    Makespan, critical path length and the time attributed to each category.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+enum EventKind
+{
+    ARRIVE,
+    ACQUIRE,
+    COMPLETE,
+    RELEASE,
+    NOTIFY,
+    LEADER_DETECT,
+    UNIT_RECREATED,
+    UNIT_LOGGED,
+    STAFF_REVIEW,
+    OTHER
+};
+
+enum Category
+{
+    CAT_ARRIVAL,
+    CAT_STATION_QUEUEING,
+    CAT_TYPING,
+    CAT_GROUP_WAITING,
+    CAT_LOGBOOK,
+    CAT_COUNT
+};
+
+const char *category_names[CAT_COUNT] = {"arrival", "station queueing", "typing", "group waiting", "logbook"};
+const char *kind_names[] = {"arrive", "acquire", "complete", "release", "notify", "leader detect",
+                            "unit recreated", "unit logged", "staff review", "other"};
+
+struct Event
+{
+    long long time; // us
+    int kind;
+    int subject;  // operative ID, unit number or staff ID
+    int station;  // 1-4 for station events
+    int rank;     // ACQUIRE: index among acquisitions of its station; UNIT_LOGGED: last logbook event
+                  // before it; STAFF_REVIEW: last writer exit before it
+};
+
+vector<Event> events;
+
+// Per-operative event indices, -1 if the event never appeared
+vector<int> arrive_at, acquire_at, complete_at, release_at, notify_at, detect_at;
+// Per-unit event indices
+vector<int> recreated_at, logged_at;
+// Station releases in log order
+vector<int> station_releases[5];
+
+int group_size = 0;
+
+void set_index(vector<int> &table, int key, int index)
+{
+    if (key < 0)
+        return;
+    if ((int)table.size() <= key)
+        table.resize(key * 2 + 1, -1);
+    table[key] = index;
+}
+
+int get_index(const vector<int> &table, int key)
+{
+    return key >= 0 && key < (int)table.size() ? table[key] : -1;
+}
+
+const char *parse_number(const char *p, const char *end, long long &value)
+{
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    return p;
+}
+
+bool starts_with(const char *p, const char *end, const char *prefix)
+{
+    size_t length = strlen(prefix);
+    return (size_t)(end - p) >= length && memcmp(p, prefix, length) == 0;
+}
+
+// Last "time <number>" on the line, or -1
+long long find_time(const char *begin, const char *end)
+{
+    for (const char *p = end - 5; p >= begin; p--)
+    {
+        if (memcmp(p, "time ", 5) == 0)
+        {
+            long long value;
+            parse_number(p + 5, end, value);
+            return value;
+        }
+    }
+    return -1;
+}
+
+struct ParseState
+{
+    long long clock = 0;         // Latest timestamp seen, us
+    int acquisitions[5] = {0};   // Acquisitions seen per station
+    int last_logbook_event = -1; // Latest writer exit or reader entry
+    int last_writer = -1;        // Latest writer exit
+};
+
+void parse_line(const char *p, const char *end, ParseState &state)
+{
+    Event event = {0, OTHER, 0, 0, -1};
+    long long number = 0;
+
+    // Optional "#<seq> <time><unit> " stamp
+    long long stamp_us = -1;
+    if (p < end && *p == '#')
+    {
+        p = parse_number(p + 1, end, number);
+        p = parse_number(p + 1, end, stamp_us);
+        if (starts_with(p, end, "ns"))
+            stamp_us /= 1000;
+        while (p < end && *p != ' ')
+            p++;
+        p++;
+    }
+
+    if (starts_with(p, end, "Operative "))
+    {
+        p = parse_number(p + 10, end, number);
+        event.subject = (int)number;
+        if (starts_with(p, end, " has arrived"))
+            event.kind = ARRIVE;
+        else if (starts_with(p, end, " has acquired station "))
+            event.kind = ACQUIRE;
+        else if (starts_with(p, end, " has completed document recreation"))
+            event.kind = COMPLETE;
+        else if (starts_with(p, end, " has released station "))
+            event.kind = RELEASE;
+        else if (starts_with(p, end, " has finished and notified"))
+            event.kind = NOTIFY;
+        else
+            return; // Requests and waits carry no dependency information
+
+        if (event.kind == ARRIVE || event.kind == ACQUIRE || event.kind == COMPLETE || event.kind == RELEASE)
+        {
+            const char *station = p;
+            while (station < end && (*station < '0' || *station > '9'))
+                station++;
+            parse_number(station, end, number);
+            event.station = (int)number;
+        }
+    }
+    else if (starts_with(p, end, "Leader Operative "))
+    {
+        p = parse_number(p + 17, end, number);
+        if (!starts_with(p, end, " detected all group members finished"))
+            return;
+        event.kind = LEADER_DETECT;
+        event.subject = (int)number;
+    }
+    else if (starts_with(p, end, "Unit "))
+    {
+        p = parse_number(p + 5, end, number);
+        event.subject = (int)number;
+        if (starts_with(p, end, " has completed document recreation phase"))
+            event.kind = UNIT_RECREATED;
+        else if (starts_with(p, end, " has completed intelligence distribution"))
+            event.kind = UNIT_LOGGED;
+        else
+            return;
+    }
+    else if (starts_with(p, end, "Intelligence Staff "))
+    {
+        parse_number(p + 19, end, number);
+        event.kind = STAFF_REVIEW;
+        event.subject = (int)number;
+    }
+    else
+    {
+        return;
+    }
+
+    long long stamped = stamp_us >= 0 ? stamp_us : find_time(p, end) * 1000;
+    if (stamped > state.clock)
+        state.clock = stamped;
+    event.time = state.clock;
+
+    int index = (int)events.size();
+    switch (event.kind)
+    {
+    case ARRIVE:
+        set_index(arrive_at, event.subject, index);
+        break;
+    case ACQUIRE:
+        if (event.station >= 1 && event.station <= 4)
+            event.rank = state.acquisitions[event.station]++;
+        set_index(acquire_at, event.subject, index);
+        break;
+    case COMPLETE:
+        set_index(complete_at, event.subject, index);
+        break;
+    case RELEASE:
+        if (event.station >= 1 && event.station <= 4)
+            station_releases[event.station].push_back(index);
+        set_index(release_at, event.subject, index);
+        break;
+    case NOTIFY:
+        set_index(notify_at, event.subject, index);
+        break;
+    case LEADER_DETECT:
+        set_index(detect_at, event.subject, index);
+        break;
+    case UNIT_RECREATED:
+        set_index(recreated_at, event.subject, index);
+        break;
+    case UNIT_LOGGED:
+        // A writer enters after the previous writer and every earlier reader have left
+        event.rank = state.last_logbook_event;
+        set_index(logged_at, event.subject, index);
+        state.last_logbook_event = index;
+        state.last_writer = index;
+        break;
+    case STAFF_REVIEW:
+        // Readers overlap each other, so a reader only waits for the previous writer
+        event.rank = state.last_writer;
+        state.last_logbook_event = index;
+        break;
+    }
+    events.push_back(event);
+}
+
+// Consider candidate as the binding predecessor of the current event
+void consider(int candidate, Category category, int &best, Category &best_category)
+{
+    if (candidate < 0)
+        return;
+    if (best < 0 || events[candidate].time > events[best].time ||
+        (events[candidate].time == events[best].time && candidate > best))
+    {
+        best = candidate;
+        best_category = category;
+    }
+}
+
+// Predecessor that finished last, and the category charged for the step from it; -1 at the start of the run
+int binding_predecessor(int index, Category &category)
+{
+    const Event &event = events[index];
+    int best = -1;
+    category = CAT_ARRIVAL;
+    switch (event.kind)
+    {
+    case ACQUIRE:
+        consider(get_index(arrive_at, event.subject), CAT_STATION_QUEUEING, best, category);
+        if (event.rank > 0 && event.rank - 1 < (int)station_releases[event.station].size())
+            consider(station_releases[event.station][event.rank - 1], CAT_STATION_QUEUEING, best, category);
+        break;
+    case COMPLETE:
+        consider(get_index(acquire_at, event.subject), CAT_TYPING, best, category);
+        break;
+    case RELEASE:
+        consider(get_index(complete_at, event.subject), CAT_TYPING, best, category);
+        break;
+    case NOTIFY:
+        consider(get_index(release_at, event.subject), CAT_GROUP_WAITING, best, category);
+        break;
+    case LEADER_DETECT:
+        consider(get_index(release_at, event.subject), CAT_GROUP_WAITING, best, category);
+        if (group_size > 0)
+            for (int member = event.subject - group_size + 1; member < event.subject; member++)
+                consider(get_index(notify_at, member), CAT_GROUP_WAITING, best, category);
+        break;
+    case UNIT_RECREATED:
+        if (group_size > 0)
+            consider(get_index(detect_at, event.subject * group_size), CAT_GROUP_WAITING, best, category);
+        break;
+    case UNIT_LOGGED:
+        consider(get_index(recreated_at, event.subject), CAT_LOGBOOK, best, category);
+        consider(event.rank, CAT_LOGBOOK, best, category);
+        break;
+    case STAFF_REVIEW:
+        consider(event.rank, CAT_LOGBOOK, best, category);
+        break;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3 || (argc == 3 && string(argv[2]) != "--path"))
+    {
+        cout << "Usage: ./critical_path_analyzer.out <output_file> [--path]" << endl;
+        return 0;
+    }
+    bool print_path = argc == 3;
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        cout << "Cannot read " << argv[1] << endl;
+        return 0;
+    }
+    const char *data = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        cout << "Cannot map " << argv[1] << endl;
+        return 0;
+    }
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+    events.reserve(st.st_size / 48);
+    ParseState state;
+    const char *end = data + st.st_size;
+    for (const char *line = data; line < end;)
+    {
+        const char *line_end = (const char *)memchr(line, '\n', end - line);
+        if (line_end == NULL)
+            line_end = end;
+        parse_line(line, line_end, state);
+        line = line_end + 1;
+    }
+    munmap((void *)data, st.st_size);
+
+    // The group size is not in the log; leaders are multiples of it, and unit 1's leader is the smallest
+    for (int i = 1; i < (int)detect_at.size() && group_size == 0; i++)
+        if (detect_at[i] >= 0)
+            group_size = i;
+
+    if (events.empty())
+    {
+        cout << "No events found in " << argv[1] << endl;
+        return 0;
+    }
+    // The run ends at the last logbook entry, or at the last event if no unit was logged
+    int sink = (int)events.size() - 1;
+    for (int i = 0; i < (int)events.size(); i++)
+        if (events[i].kind == UNIT_LOGGED && (events[sink].kind != UNIT_LOGGED || events[i].time >= events[sink].time))
+            sink = i;
+
+    // Lines can be printed slightly out of causal order (a release after the next acquire), so a
+    // predecessor's time is capped at its successor's; the steps then add up to the makespan exactly
+    long long attributed[CAT_COUNT] = {0};
+    vector<int> path;
+    long long ceiling = events[sink].time;
+    for (int current = sink; current >= 0;)
+    {
+        path.push_back(current);
+        Category category;
+        int predecessor = binding_predecessor(current, category);
+        long long from = predecessor >= 0 ? min(ceiling, events[predecessor].time) : 0;
+        attributed[category] += ceiling - from;
+        ceiling = from;
+        current = predecessor;
+    }
+
+    long long makespan = events[sink].time;
+    cout << "Events parsed: " << events.size() << endl;
+    cout << "Group size: " << group_size << endl;
+    cout << fixed << setprecision(3);
+    cout << "Makespan: " << makespan / 1000.0 << " ms" << endl;
+    cout << "Critical path: " << path.size() << " events" << endl;
+    for (int c = 0; c < CAT_COUNT; c++)
+    {
+        cout << "  " << category_names[c] << ": " << attributed[c] / 1000.0 << " ms";
+        if (makespan > 0)
+            cout << " (" << attributed[c] * 100 / makespan << "%)";
+        cout << endl;
+    }
+
+    if (print_path)
+    {
+        for (int i = (int)path.size() - 1; i >= 0; i--)
+        {
+            const Event &event = events[path[i]];
+            cout << event.time / 1000.0 << " ms\t" << kind_names[event.kind] << " " << event.subject;
+            if (event.station > 0)
+                cout << " (station " << event.station << ")";
+            cout << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,481 @@
+/*
+  This program grows simple_sum_calculation.cpp into a reusable parallel
+  reduction facility and benchmarks it against the original approach.
+
+  How it works:
+    - ThreadPool starts its worker threads once; every reduction hands the
+  workers a job and waits for all of them, so repeated reductions do not pay
+  for pthread_create/pthread_join.
+    - Each worker reduces its own contiguous slice into a Partial that is
+  aligned to a cache line. In simple_sum_calculation.cpp the ThreadData
+  entries are packed next to each other, so threads that update their sum
+  inside the loop keep stealing the same cache line from each other (false
+  sharing).
+    - Reduction operators are pluggable: an operator supplies an identity, a
+  combine step, and a kernel that reduces one slice. SumOp, MinOp and MaxOp
+  have AVX-512 and AVX2 kernels plus a scalar fallback, chosen once at startup
+  from what the CPU supports. HistogramOp reduces a slice into a vector of
+  bins (counted in four interleaved copies to break store-to-load
+  dependencies) and combines vectors bin by bin.
+    - The benchmark reduces the same array with the original approach (packed
+  partials, new threads per call, built without optimization like the course
+  compiles it) and with every kernel of the new facility, for 1, 2, 4, ...
+  threads, and prints the best throughput of several repetitions in GB/s.
+
+  Compilation:
+    g++ -O2 -pthread parallel_reduce.cpp -o a.out
+
+  Usage:
+    ./a.out [elements] [max_threads]
+
+    elements defaults to 64M 32-bit values (256 MB); max_threads defaults to
+  twice the number of online CPUs.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Thread pool: workers wait for a new generation, run the job, report back
+// ---------------------------------------------------------------------------
+class ThreadPool {
+public:
+  explicit ThreadPool(int count) : workers(count) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&start, NULL);
+    pthread_cond_init(&done, NULL);
+    for (int i = 0; i < count; i++) {
+      WorkerArg *arg = new WorkerArg{this, i};
+      pthread_create(&workers[i], NULL, worker_main, arg);
+    }
+  }
+
+  ~ThreadPool() {
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    generation++;
+    pthread_cond_broadcast(&start);
+    pthread_mutex_unlock(&mutex);
+    for (pthread_t &worker : workers)
+      pthread_join(worker, NULL);
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&start);
+    pthread_cond_destroy(&done);
+  }
+
+  int size() const { return workers.size(); }
+
+  // Runs job(index, count) on every worker and returns when all are finished
+  void run(const function<void(int, int)> &job) {
+    pthread_mutex_lock(&mutex);
+    current = &job;
+    remaining = workers.size();
+    generation++;
+    pthread_cond_broadcast(&start);
+    while (remaining > 0)
+      pthread_cond_wait(&done, &mutex);
+    current = NULL;
+    pthread_mutex_unlock(&mutex);
+  }
+
+private:
+  struct WorkerArg {
+    ThreadPool *pool;
+    int index;
+  };
+
+  static void *worker_main(void *arg) {
+    WorkerArg *worker = (WorkerArg *)arg;
+    ThreadPool *pool = worker->pool;
+    int index = worker->index;
+    delete worker;
+
+    unsigned long seen = 0;
+    while (true) {
+      pthread_mutex_lock(&pool->mutex);
+      while (pool->generation == seen)
+        pthread_cond_wait(&pool->start, &pool->mutex);
+      seen = pool->generation;
+      if (pool->stopping) {
+        pthread_mutex_unlock(&pool->mutex);
+        return NULL;
+      }
+      const function<void(int, int)> *job = pool->current;
+      pthread_mutex_unlock(&pool->mutex);
+
+      (*job)(index, pool->size());
+
+      pthread_mutex_lock(&pool->mutex);
+      if (--pool->remaining == 0)
+        pthread_cond_signal(&pool->done);
+      pthread_mutex_unlock(&pool->mutex);
+    }
+  }
+
+  vector<pthread_t> workers;
+  pthread_mutex_t mutex;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  const function<void(int, int)> *current = NULL;
+  unsigned long generation = 0;
+  int remaining = 0;
+  bool stopping = false;
+};
+
+// One accumulator per thread, alone on its cache line
+template <typename T> struct alignas(64) Partial {
+  T value;
+};
+
+// Slice [begin, end) of n elements handled by worker index out of count
+void slice(size_t n, int index, int count, size_t &begin, size_t &end) {
+  begin = n * index / count;
+  end = n * (index + 1) / count;
+}
+
+template <typename Op>
+typename Op::Result parallel_reduce(ThreadPool &pool, const int32_t *data,
+                                    size_t n) {
+  vector<Partial<typename Op::Result>> partials(pool.size());
+  pool.run([&](int index, int count) {
+    size_t begin, end;
+    slice(n, index, count, begin, end);
+    partials[index].value = Op::kernel(data + begin, end - begin);
+  });
+  typename Op::Result result = Op::identity();
+  for (auto &partial : partials)
+    result = Op::combine(result, partial.value);
+  return result;
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+enum KernelLevel { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512 };
+const char *kernel_names[] = {"scalar", "avx2", "avx512"};
+KernelLevel kernel_level = KERNEL_SCALAR; // Used by the operators below
+
+int64_t sum_scalar(const int32_t *data, size_t n) {
+  int64_t sum = 0;
+  for (size_t i = 0; i < n; i++)
+    sum += data[i];
+  return sum;
+}
+
+int32_t min_scalar(const int32_t *data, size_t n) {
+  int32_t value = INT32_MAX;
+  for (size_t i = 0; i < n; i++)
+    value = min(value, data[i]);
+  return value;
+}
+
+int32_t max_scalar(const int32_t *data, size_t n) {
+  int32_t value = INT32_MIN;
+  for (size_t i = 0; i < n; i++)
+    value = max(value, data[i]);
+  return value;
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2"))) int64_t sum_avx2(const int32_t *data,
+                                                 size_t n) {
+  __m256i low = _mm256_setzero_si256(), high = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+    low = _mm256_add_epi64(low, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+    high = _mm256_add_epi64(high, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+  }
+  int64_t lanes[4];
+  _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(low, high));
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_scalar(data + i, n - i);
+}
+
+__attribute__((target("avx2"))) int32_t min_avx2(const int32_t *data,
+                                                 size_t n) {
+  __m256i value = _mm256_set1_epi32(INT32_MAX);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    value = _mm256_min_epi32(value, _mm256_loadu_si256((const __m256i *)(data + i)));
+  int32_t lanes[8];
+  _mm256_storeu_si256((__m256i *)lanes, value);
+  return min(*min_element(lanes, lanes + 8), min_scalar(data + i, n - i));
+}
+
+__attribute__((target("avx2"))) int32_t max_avx2(const int32_t *data,
+                                                 size_t n) {
+  __m256i value = _mm256_set1_epi32(INT32_MIN);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    value = _mm256_max_epi32(value, _mm256_loadu_si256((const __m256i *)(data + i)));
+  int32_t lanes[8];
+  _mm256_storeu_si256((__m256i *)lanes, value);
+  return max(*max_element(lanes, lanes + 8), max_scalar(data + i, n - i));
+}
+
+// GCC 12 reports uninitialized variables inside its own AVX-512 headers
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f"))) int64_t sum_avx512(const int32_t *data,
+                                                      size_t n) {
+  __m512i low = _mm512_setzero_si512(), high = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    low = _mm512_add_epi64(low, _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i *)(data + i))));
+    high = _mm512_add_epi64(high, _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i *)(data + i + 8))));
+  }
+  int64_t lanes[8];
+  _mm512_storeu_si512((void *)lanes, _mm512_add_epi64(low, high));
+  int64_t sum = 0;
+  for (int64_t lane : lanes)
+    sum += lane;
+  return sum + sum_scalar(data + i, n - i);
+}
+
+__attribute__((target("avx512f"))) int32_t min_avx512(const int32_t *data,
+                                                      size_t n) {
+  __m512i value = _mm512_set1_epi32(INT32_MAX);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    value = _mm512_min_epi32(value, _mm512_loadu_si512((const void *)(data + i)));
+  int32_t lanes[16];
+  _mm512_storeu_si512((void *)lanes, value);
+  return min(*min_element(lanes, lanes + 16), min_scalar(data + i, n - i));
+}
+
+__attribute__((target("avx512f"))) int32_t max_avx512(const int32_t *data,
+                                                      size_t n) {
+  __m512i value = _mm512_set1_epi32(INT32_MIN);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    value = _mm512_max_epi32(value, _mm512_loadu_si512((const void *)(data + i)));
+  int32_t lanes[16];
+  _mm512_storeu_si512((void *)lanes, value);
+  return max(*max_element(lanes, lanes + 16), max_scalar(data + i, n - i));
+}
+#pragma GCC diagnostic pop
+#endif
+
+// Best kernel level this CPU can run
+KernelLevel detect_kernel_level() {
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return KERNEL_AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return KERNEL_AVX2;
+#endif
+  return KERNEL_SCALAR;
+}
+
+// ---------------------------------------------------------------------------
+// Operators
+// ---------------------------------------------------------------------------
+struct SumOp {
+  typedef int64_t Result;
+  static Result identity() { return 0; }
+  static Result combine(Result a, Result b) { return a + b; }
+  static Result kernel(const int32_t *data, size_t n) {
+#ifdef HAVE_X86_KERNELS
+    if (kernel_level == KERNEL_AVX512)
+      return sum_avx512(data, n);
+    if (kernel_level == KERNEL_AVX2)
+      return sum_avx2(data, n);
+#endif
+    return sum_scalar(data, n);
+  }
+};
+
+struct MinOp {
+  typedef int32_t Result;
+  static Result identity() { return INT32_MAX; }
+  static Result combine(Result a, Result b) { return min(a, b); }
+  static Result kernel(const int32_t *data, size_t n) {
+#ifdef HAVE_X86_KERNELS
+    if (kernel_level == KERNEL_AVX512)
+      return min_avx512(data, n);
+    if (kernel_level == KERNEL_AVX2)
+      return min_avx2(data, n);
+#endif
+    return min_scalar(data, n);
+  }
+};
+
+struct MaxOp {
+  typedef int32_t Result;
+  static Result identity() { return INT32_MIN; }
+  static Result combine(Result a, Result b) { return max(a, b); }
+  static Result kernel(const int32_t *data, size_t n) {
+#ifdef HAVE_X86_KERNELS
+    if (kernel_level == KERNEL_AVX512)
+      return max_avx512(data, n);
+    if (kernel_level == KERNEL_AVX2)
+      return max_avx2(data, n);
+#endif
+    return max_scalar(data, n);
+  }
+};
+
+// Histogram of values in [LOW, LOW + BINS * WIDTH); out-of-range values are
+// clamped to the first or last bin
+template <int32_t LOW, int32_t WIDTH, int BINS> struct HistogramOp {
+  typedef vector<uint64_t> Result;
+  static int bin(int32_t value) {
+    int b = (value - LOW) / WIDTH;
+    return b < 0 ? 0 : b >= BINS ? BINS - 1 : b;
+  }
+  static Result identity() { return Result(BINS, 0); }
+  static Result combine(Result a, const Result &b) {
+    for (int i = 0; i < BINS; i++)
+      a[i] += b[i];
+    return a;
+  }
+  static Result kernel(const int32_t *data, size_t n) {
+    vector<uint64_t> counts(4 * BINS, 0);
+    for (size_t i = 0; i < n; i++)
+      counts[(i & 3) * BINS + bin(data[i])]++;
+    Result histogram = identity();
+    for (int copy = 0; copy < 4; copy++)
+      for (int b = 0; b < BINS; b++)
+        histogram[b] += counts[copy * BINS + b];
+    return histogram;
+  }
+};
+
+typedef HistogramOp<-500000, 10000, 100> BenchHistogramOp;
+
+// ---------------------------------------------------------------------------
+// The original approach, for comparison
+// ---------------------------------------------------------------------------
+class ThreadData {
+public:
+  const int32_t *data;
+  long start;
+  long end;
+  long long sum;
+};
+
+// Built without optimization, as the course compiles simple_sum_calculation.cpp,
+// so the partial sum is stored to the shared cache line on every iteration
+__attribute__((optimize("O0"))) void *computeSum(void *arg) {
+  ThreadData *data = (ThreadData *)arg;
+  data->sum = 0;
+  for (long i = data->start; i < data->end; i++) {
+    data->sum += data->data[i];
+  }
+  return NULL;
+}
+
+long long original_sum(const int32_t *values, size_t n, int M) {
+  vector<pthread_t> threads(M);
+  vector<ThreadData> data(M);
+  for (int i = 0; i < M; i++) {
+    data[i].data = values;
+    data[i].start = (long)(n * i / M);
+    data[i].end = (long)(n * (i + 1) / M);
+    pthread_create(&threads[i], NULL, computeSum, (void *)&data[i]);
+  }
+  long long sum = 0;
+  for (int i = 0; i < M; i++) {
+    pthread_join(threads[i], NULL);
+    sum += data[i].sum;
+  }
+  return sum;
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark
+// ---------------------------------------------------------------------------
+const int REPETITIONS = 5;
+
+// Best GB/s of several repetitions of run(), which must process bytes bytes
+double best_gbps(size_t bytes, const function<void()> &run) {
+  double best = 0;
+  for (int r = 0; r < REPETITIONS; r++) {
+    auto begin = chrono::steady_clock::now();
+    run();
+    double seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    best = max(best, bytes / seconds / 1e9);
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? atol(argv[1]) : (size_t)64 << 20;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int max_threads = argc > 2 ? atoi(argv[2]) : (int)(2 * cpus);
+  if (n == 0 || max_threads <= 0) {
+    printf("Usage: ./a.out [elements] [max_threads]\n");
+    return 0;
+  }
+
+  vector<int32_t> values(n);
+  unsigned state = 12345;
+  long long expected = 0;
+  for (size_t i = 0; i < n; i++) {
+    state = state * 1103515245 + 12345;
+    values[i] = (int32_t)(state >> 8) % 1000000 - 500000;
+    expected += values[i];
+  }
+  const int32_t *data = values.data();
+  size_t bytes = n * sizeof(int32_t);
+  KernelLevel best_level = detect_kernel_level();
+
+  printf("%zu elements (%.0f MB), %ld online CPUs, best kernel %s\n", n,
+         bytes / 1e6, cpus, kernel_names[best_level]);
+  printf("threads\toriginal\tscalar\t");
+  if (best_level >= KERNEL_AVX2)
+    printf("avx2\t");
+  if (best_level >= KERNEL_AVX512)
+    printf("avx512\t");
+  printf("min\tmax\thistogram\t(sum unless noted, GB/s)\n");
+
+  bool correct = true;
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    ThreadPool pool(threads);
+    printf("%d", threads);
+    printf("\t%.2f", best_gbps(bytes, [&] {
+             correct &= original_sum(data, n, threads) == expected;
+           }));
+    for (int level = KERNEL_SCALAR; level <= best_level; level++) {
+      kernel_level = (KernelLevel)level;
+      printf("\t%.2f", best_gbps(bytes, [&] {
+               correct &= parallel_reduce<SumOp>(pool, data, n) == expected;
+             }));
+    }
+    kernel_level = best_level;
+    printf("\t%.2f", best_gbps(bytes, [&] { parallel_reduce<MinOp>(pool, data, n); }));
+    printf("\t%.2f", best_gbps(bytes, [&] { parallel_reduce<MaxOp>(pool, data, n); }));
+    printf("\t%.2f", best_gbps(bytes, [&] { parallel_reduce<BenchHistogramOp>(pool, data, n); }));
+    printf("\n");
+    fflush(stdout);
+  }
+
+  // Cross-check the operators against straightforward scalar code
+  ThreadPool pool(max_threads);
+  kernel_level = best_level;
+  correct &= parallel_reduce<MinOp>(pool, data, n) == *min_element(values.begin(), values.end());
+  correct &= parallel_reduce<MaxOp>(pool, data, n) == *max_element(values.begin(), values.end());
+  vector<uint64_t> histogram(100, 0);
+  for (int32_t value : values)
+    histogram[min(99L, max(0L, ((long)value + 500000) / 10000))]++;
+  correct &= parallel_reduce<BenchHistogramOp>(pool, data, n) == histogram;
+  printf("Results %s\n", correct ? "verified" : "MISMATCH");
+  return 0;
+}
@@ -0,0 +1,230 @@
+/*
+  Bulk Poisson sampling: fill an array with N Poisson(lambda) draws, instead of
+  building a generator and a std::poisson_distribution for every single value
+  as get_random_number() in poisson_random_number_generator.cpp does.
+
+  How it works:
+    - Random bits come from Philox4x32-10, a counter-based generator: the
+  output is a pure function of (key, counter), so there is no state to carry
+  between draws and any thread can produce any part of the stream. The key is
+  the seed; the counter holds the chunk number and the candidate number inside
+  the chunk.
+    - The array is cut into fixed chunks of POISSON_CHUNK draws and threads take
+  chunks from a shared counter. Because chunk c always uses the counters of
+  chunk c, the result depends only on (seed, lambda, method, n), not on how
+  many threads filled it.
+    - POISSON_INVERSION (small lambda): exact inversion, a uniform is looked up
+  in a precomputed CDF table (the tail beyond the table is below 1e-16).
+    - POISSON_PTRS (large lambda): Hormann's transformed rejection with squeeze
+  (PTRS), which is exact. Candidates are generated a block at a time in plain
+  loops the compiler can vectorize; about 90% of them pass the cheap squeeze
+  test and only the rest need the log/lgamma acceptance test.
+    - POISSON_NORMAL: round(lambda + sqrt(lambda) * Z). Fastest but only an
+  approximation; its skew is wrong, which is visible for moderate lambda.
+    - POISSON_AUTO picks inversion below lambda 10 and PTRS above; the exact
+  methods fall back to each other outside their valid range.
+
+  Interface:
+    poisson_fill(out, n, lambda, seed, threads, method)
+*/
+
+#ifndef POISSON_SAMPLER_H
+#define POISSON_SAMPLER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <pthread.h>
+#include <vector>
+
+#define POISSON_CHUNK 65536 // Draws per chunk; also the unit of work of a thread
+#define POISSON_BLOCK 64    // Candidates generated together in the PTRS loop
+
+enum PoissonMethod { POISSON_AUTO, POISSON_INVERSION, POISSON_PTRS, POISSON_NORMAL };
+
+// ---------------------------------------------------------------------------
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+// ---------------------------------------------------------------------------
+struct PhiloxOutput {
+  uint32_t v[4];
+};
+
+static inline PhiloxOutput philox4x32(uint64_t counter_low, uint64_t counter_high,
+                                      uint64_t key) {
+  uint32_t c0 = (uint32_t)counter_low, c1 = (uint32_t)(counter_low >> 32);
+  uint32_t c2 = (uint32_t)counter_high, c3 = (uint32_t)(counter_high >> 32);
+  uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+  for (int round = 0; round < 10; round++) {
+    uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+    uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    c0 = n0;
+    c2 = n2;
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+  return {{c0, c1, c2, c3}};
+}
+
+// 53-bit uniform strictly inside (0, 1), so log() of it is always finite
+static inline double philox_uniform(uint32_t high, uint32_t low) {
+  uint64_t bits = (((uint64_t)high << 32) | low) >> 11;
+  return ((double)bits + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// ---------------------------------------------------------------------------
+// Per-lambda constants
+// ---------------------------------------------------------------------------
+struct PoissonSetup {
+  PoissonMethod method;
+  double lambda;
+  std::vector<double> cdf; // Inversion
+  double sqrt_lambda, log_lambda, a, b, log_inv_alpha, v_r; // PTRS and normal
+};
+
+inline PoissonSetup poisson_setup(double lambda, PoissonMethod method) {
+  PoissonSetup setup;
+  lambda = std::max(lambda, 0.0);
+  // PTRS needs lambda >= 10; the inversion table underflows (exp(-lambda) == 0) for large lambda
+  if (method == POISSON_AUTO || (method == POISSON_PTRS && lambda < 10) ||
+      (method == POISSON_INVERSION && lambda > 500))
+    method = lambda < 10 ? POISSON_INVERSION : POISSON_PTRS;
+  setup.method = method;
+  setup.lambda = lambda;
+  setup.sqrt_lambda = std::sqrt(lambda);
+  setup.log_lambda = std::log(lambda);
+  if (method == POISSON_INVERSION) {
+    double pmf = std::exp(-lambda), total = 0;
+    for (int k = 0; k <= lambda || pmf > 1e-17 * total; k++) {
+      total += pmf;
+      setup.cdf.push_back(total);
+      pmf *= lambda / (k + 1);
+    }
+  }
+  if (method == POISSON_PTRS) {
+    setup.b = 0.931 + 2.53 * setup.sqrt_lambda;
+    setup.a = -0.059 + 0.02483 * setup.b;
+    setup.log_inv_alpha = std::log(1.1239 + 1.1328 / (setup.b - 3.4));
+    setup.v_r = 0.9277 - 3.6224 / (setup.b - 2);
+  }
+  return setup;
+}
+
+// ---------------------------------------------------------------------------
+// Chunk kernels: fill out[0..n) from the counters of one chunk
+// ---------------------------------------------------------------------------
+inline void poisson_chunk_inversion(const PoissonSetup &setup, int *out, size_t n,
+                                    uint64_t chunk, uint64_t seed) {
+  const double *cdf = setup.cdf.data();
+  int last = (int)setup.cdf.size() - 1;
+  for (size_t i = 0; i < n; i += 2) {
+    PhiloxOutput r = philox4x32(i / 2, chunk, seed);
+    double u[2] = {philox_uniform(r.v[0], r.v[1]), philox_uniform(r.v[2], r.v[3])};
+    for (size_t j = 0; j < 2 && i + j < n; j++) {
+      int k = 0; // Mean search length is lambda + 1, short for the lambdas this is used for
+      while (k < last && u[j] > cdf[k])
+        k++;
+      out[i + j] = k;
+    }
+  }
+}
+
+inline void poisson_chunk_ptrs(const PoissonSetup &setup, int *out, size_t n,
+                               uint64_t chunk, uint64_t seed) {
+  const double lambda = setup.lambda, a = setup.a, b = setup.b, v_r = setup.v_r;
+  double us[POISSON_BLOCK], v[POISSON_BLOCK], k[POISSON_BLOCK];
+  bool fast[POISSON_BLOCK];
+  size_t filled = 0;
+  for (uint64_t candidate = 0; filled < n; candidate += POISSON_BLOCK) {
+    // Candidate generation and the squeeze test, free of branches
+    for (int i = 0; i < POISSON_BLOCK; i++) {
+      PhiloxOutput r = philox4x32(candidate + i, chunk, seed);
+      double u = philox_uniform(r.v[0], r.v[1]) - 0.5;
+      v[i] = philox_uniform(r.v[2], r.v[3]);
+      us[i] = 0.5 - std::fabs(u);
+      k[i] = std::floor((2 * a / us[i] + b) * u + lambda + 0.43);
+      fast[i] = us[i] >= 0.07 && v[i] <= v_r;
+    }
+    for (int i = 0; i < POISSON_BLOCK && filled < n; i++) {
+      if (fast[i]) {
+        out[filled++] = (int)k[i];
+        continue;
+      }
+      if (k[i] < 0 || (us[i] < 0.013 && v[i] > us[i]))
+        continue;
+      double lhs = std::log(v[i]) + setup.log_inv_alpha - std::log(a / (us[i] * us[i]) + b);
+      int sign; // lgamma_r: plain lgamma writes the global signgam from every thread
+      double rhs = -lambda + k[i] * setup.log_lambda - lgamma_r(k[i] + 1, &sign);
+      if (lhs <= rhs)
+        out[filled++] = (int)k[i];
+    }
+  }
+}
+
+inline void poisson_chunk_normal(const PoissonSetup &setup, int *out, size_t n,
+                                 uint64_t chunk, uint64_t seed) {
+  for (size_t i = 0; i < n; i += 2) {
+    PhiloxOutput r = philox4x32(i / 2, chunk, seed);
+    // Box-Muller gives two independent normals per pair of uniforms
+    double radius = std::sqrt(-2 * std::log(philox_uniform(r.v[0], r.v[1])));
+    double angle = 2 * M_PI * philox_uniform(r.v[2], r.v[3]);
+    double z[2] = {radius * std::cos(angle), radius * std::sin(angle)};
+    for (size_t j = 0; j < 2 && i + j < n; j++)
+      out[i + j] = (int)std::max(0.0, std::floor(setup.lambda + setup.sqrt_lambda * z[j] + 0.5));
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Multithreaded fill
+// ---------------------------------------------------------------------------
+struct PoissonJob {
+  const PoissonSetup *setup;
+  int *out;
+  size_t n;
+  uint64_t seed;
+  std::atomic<size_t> next_chunk{0};
+};
+
+inline void *poisson_worker(void *arg) {
+  PoissonJob *job = (PoissonJob *)arg;
+  size_t chunks = (job->n + POISSON_CHUNK - 1) / POISSON_CHUNK;
+  for (size_t c; (c = job->next_chunk.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+    size_t begin = c * POISSON_CHUNK, count = std::min((size_t)POISSON_CHUNK, job->n - begin);
+    switch (job->setup->method) {
+    case POISSON_INVERSION:
+      poisson_chunk_inversion(*job->setup, job->out + begin, count, c, job->seed);
+      break;
+    case POISSON_NORMAL:
+      poisson_chunk_normal(*job->setup, job->out + begin, count, c, job->seed);
+      break;
+    default:
+      poisson_chunk_ptrs(*job->setup, job->out + begin, count, c, job->seed);
+      break;
+    }
+  }
+  return NULL;
+}
+
+// Fills out[0..n) with Poisson(lambda) draws using `threads` threads (the caller counts as one)
+inline void poisson_fill(int *out, size_t n, double lambda, uint64_t seed, int threads = 1,
+                         PoissonMethod method = POISSON_AUTO) {
+  PoissonSetup setup = poisson_setup(lambda, method);
+  PoissonJob job;
+  job.setup = &setup;
+  job.out = out;
+  job.n = n;
+  job.seed = seed;
+  std::vector<pthread_t> helpers(std::max(0, threads - 1));
+  for (pthread_t &thread : helpers)
+    pthread_create(&thread, NULL, poisson_worker, &job);
+  poisson_worker(&job);
+  for (pthread_t &thread : helpers)
+    pthread_join(thread, NULL);
+}
+
+#endif
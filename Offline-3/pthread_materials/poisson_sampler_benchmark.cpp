@@ -0,0 +1,166 @@
+/*
+  This program benchmarks the bulk Poisson sampler of poisson_sampler.h
+  against std::poisson_distribution, and checks that its draws really follow
+  the Poisson distribution.
+
+  How it works:
+    - For several lambdas (including the 10000.234 of
+  poisson_random_number_generator.cpp) it measures draws per second of:
+      the get_random_number() pattern (new random_device + mt19937 +
+      distribution per draw; on a smaller sample, it is very slow),
+      std::poisson_distribution with one mt19937 kept across draws,
+      poisson_fill() with 1 thread and with all threads,
+      and the normal approximation.
+    - Goodness of fit: the draws of each method are binned and compared with
+  the exact Poisson probabilities by a chi-square test (tail bins merged so
+  every bin expects at least 5 draws). The p-value uses the Wilson-Hilferty
+  normal approximation of the chi-square distribution. Exact samplers should
+  give p-values spread over (0, 1); a p-value of ~0 means the draws are not
+  Poisson (expected for the normal approximation at moderate lambda).
+    - It also checks that a multithreaded fill gives exactly the same array as
+  a single-threaded one.
+
+  Compilation:
+    g++ -O2 -pthread poisson_sampler_benchmark.cpp -o a.out
+    (-O3 -march=native lets the compiler vectorize more of the candidate loop)
+
+  Usage:
+    ./a.out [draws] [threads]
+
+    draws defaults to 10000000 per method and lambda; threads defaults to the
+  number of online CPUs.
+*/
+
+#include "poisson_sampler.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+using namespace std;
+
+double seconds_since(chrono::steady_clock::time_point begin) {
+  return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+// The per-call pattern of get_random_number(), with lambda as a parameter
+int get_random_number(double lambda) {
+  random_device rd;
+  mt19937 generator(rd());
+  poisson_distribution<int> poissonDist(lambda);
+  return poissonDist(generator);
+}
+
+struct Fit {
+  double chi_square;
+  int df;
+  double p_value;
+  double mean, variance;
+};
+
+Fit goodness_of_fit(const vector<int> &draws, double lambda) {
+  Fit fit;
+  double n = draws.size(), sum = 0, sum_sq = 0;
+  for (int x : draws) {
+    sum += x;
+    sum_sq += (double)x * x;
+  }
+  fit.mean = sum / n;
+  fit.variance = sum_sq / n - fit.mean * fit.mean;
+
+  // Bins [low, high] around the mode with expected counts >= 5; tails go to the end bins
+  auto expected = [&](int k) { return n * exp(-lambda + k * log(lambda) - lgamma(k + 1.0)); };
+  int mode = (int)lambda, low = mode, high = mode;
+  while (low > 0 && expected(low - 1) >= 5)
+    low--;
+  while (expected(high + 1) >= 5)
+    high++;
+  vector<double> observed(high - low + 1, 0), wanted(high - low + 1, 0);
+  for (int x : draws)
+    observed[min(max(x, low), high) - low]++;
+  double inner = 0;
+  for (int k = low; k <= high; k++)
+    inner += wanted[k - low] = expected(k);
+  // Fold the probability beyond the end bins into them
+  double left = 0;
+  for (int k = 0; k < low; k++)
+    left += expected(k);
+  wanted[0] += left;
+  wanted.back() += max(0.0, n - inner - left);
+
+  fit.chi_square = 0;
+  for (size_t i = 0; i < observed.size(); i++)
+    fit.chi_square += (observed[i] - wanted[i]) * (observed[i] - wanted[i]) / wanted[i];
+  fit.df = (int)observed.size() - 1;
+  double d = fit.df, z = (pow(fit.chi_square / d, 1.0 / 3) - (1 - 2 / (9 * d))) / sqrt(2 / (9 * d));
+  fit.p_value = 0.5 * erfc(z / sqrt(2.0));
+  return fit;
+}
+
+// Row label of a poisson_fill() run, e.g. "fill, PTRS, 4 threads"
+const char *fill_name(char *name, size_t size, const char *method, int threads) {
+  snprintf(name, size, "fill, %s, %d thread%s", method, threads, threads == 1 ? "" : "s");
+  return name;
+}
+
+void report(const char *name, double lambda, const vector<int> &draws, double seconds) {
+  Fit fit = goodness_of_fit(draws, lambda);
+  printf("  %-30s %12.2f %10.2f %10.2f %12.1f %6d %8.4f\n", name, draws.size() / seconds / 1e6, fit.mean,
+         fit.variance, fit.chi_square, fit.df, fit.p_value);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  long draws = argc > 1 ? atol(argv[1]) : 10000000;
+  int threads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (draws <= 0 || threads <= 0) {
+    printf("Usage: ./a.out [draws] [threads]\n");
+    return 0;
+  }
+
+  const double lambdas[] = {0.5, 4, 30, 1000, 10000.234};
+  const uint64_t seed = 2024;
+  printf("%ld draws per method, %d thread%s\n", draws, threads, threads == 1 ? "" : "s");
+  for (double lambda : lambdas) {
+    printf("\nlambda = %g\n", lambda);
+    printf("  %-30s %12s %10s %10s %12s %6s %8s\n", "method", "Mdraws/s", "mean", "variance", "chi_square",
+           "df", "p_value");
+
+    vector<int> out(draws);
+    const char *method = lambda < 10 ? "inversion" : "PTRS";
+    char name[64];
+    chrono::steady_clock::time_point begin;
+    if (lambda == lambdas[4]) {
+      vector<int> few(min(draws, 20000L));
+      begin = chrono::steady_clock::now();
+      for (int &x : few)
+        x = get_random_number(lambda);
+      report("get_random_number()", lambda, few, seconds_since(begin));
+    }
+
+    mt19937 generator(seed);
+    poisson_distribution<int> distribution(lambda);
+    begin = chrono::steady_clock::now();
+    for (int &x : out)
+      x = distribution(generator);
+    report("std::poisson_distribution", lambda, out, seconds_since(begin));
+
+    begin = chrono::steady_clock::now();
+    poisson_fill(out.data(), draws, lambda, seed, 1);
+    report(fill_name(name, sizeof(name), method, 1), lambda, out, seconds_since(begin));
+    vector<int> single = out;
+
+    begin = chrono::steady_clock::now();
+    poisson_fill(out.data(), draws, lambda, seed, threads);
+    report(fill_name(name, sizeof(name), method, threads), lambda, out, seconds_since(begin));
+    if (out != single)
+      printf("  MISMATCH: the %d-thread fill differs from the 1-thread fill\n", threads);
+
+    if (lambda >= 10) {
+      begin = chrono::steady_clock::now();
+      poisson_fill(out.data(), draws, lambda, seed, 1, POISSON_NORMAL);
+      report(fill_name(name, sizeof(name), "normal approx", 1), lambda, out, seconds_since(begin));
+    }
+  }
+  return 0;
+}
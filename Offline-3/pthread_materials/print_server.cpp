@@ -0,0 +1,458 @@
+/*
+  This program continues student_report_printing.cpp past "arrived at the
+  print station": the students' reports go through a print server with a
+  bounded job queue and several printers that print in batches.
+
+  Key points:
+    - A student submits a print job into a bounded queue (QUEUE_CAPACITY
+  jobs); if the queue is full, the student blocks until a printer makes room.
+  Submitting does not wait for the print: the job completes asynchronously and
+  the printer records its submit-to-print latency.
+    - K printer threads drain the queue in batches of up to B jobs. A printer
+  that finds at least one job waits up to the batching window for the batch to
+  fill, then prints everything it took. Printing a batch costs one setup
+  (BATCH_SETUP_TIME, the warm-up and paper feed) plus PAGE_TIME per page, so
+  larger batches spread the setup over more jobs (more jobs per second), while
+  waiting for a batch to fill delays the jobs already waiting (more latency).
+    - Simulation mode follows the students of student_report_printing.cpp
+  (write, walk to the print station, submit) and logs every step.
+    - Sweep mode replaces the students by a steady stream of jobs (Poisson
+  arrivals at a fixed rate, latency measured from the scheduled submit time so
+  a blocked submitter still counts) and reports jobs per second and
+  submit-to-print latency percentiles for every combination of printer count,
+  batch size and batching window.
+
+  Compilation:
+    g++ -O2 -pthread print_server.cpp -o a.out
+
+  Usage:
+    ./a.out <input_file> <output_file> [--printers=K] [--batch=B] [--window-ms=W]
+    ./a.out --sweep [--jobs=N] [--rate=R]
+
+    Simulation defaults: 2 printers, batches of up to 4 jobs, 2 ms window.
+    Sweep defaults: 2000 jobs per configuration offered at 2000 jobs/s, over 1,
+  2 and 4 printers, batch sizes 1, 4 and 16, and windows of 0 and 5 ms.
+
+  Input:
+    The input file should contain the number of students (N).
+    Example of input file (in.txt):
+    10
+
+  Output:
+    Simulation: the timeline of students and printers in the output file, then
+  throughput and latency. Sweep: one line per configuration on the console.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Constants
+#define MAX_WRITING_TIME 20    // Maximum time a student can spend "writing"
+#define WALKING_TO_PRINTER 10  // Maximum time taken to walk to the printer
+#define SLEEP_MULTIPLIER 1000  // Multiplier to convert seconds to milliseconds
+#define QUEUE_CAPACITY 64      // Jobs the print server holds before submitters block
+#define MAX_PAGES 5            // Pages per report, 1 to MAX_PAGES
+#define BATCH_SETUP_TIME 2000  // Microseconds of printer setup per batch
+#define PAGE_TIME 100          // Microseconds per printed page
+
+typedef std::chrono::steady_clock::time_point time_point;
+
+auto start_time = std::chrono::steady_clock::now();
+
+/**
+ * Get the elapsed time in milliseconds since the start of the simulation.
+ * @return The elapsed time in milliseconds.
+ */
+long long get_time() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start_time)
+      .count();
+}
+
+pthread_mutex_t output_lock;
+bool logging = true; // Off in sweep mode
+
+// uses mutex lock to write output to avoid interleaving
+void write_output(std::string output) {
+  if (!logging)
+    return;
+  pthread_mutex_lock(&output_lock);
+  std::cout << output;
+  pthread_mutex_unlock(&output_lock);
+}
+
+/**
+ * A report waiting to be printed.
+ */
+struct PrintJob {
+  int id;               // Submitting student (simulation) or job number (sweep)
+  int pages;            // Pages to print
+  time_point submitted; // When the job was handed to the print server
+};
+
+/**
+ * Bounded FIFO of print jobs, guarded by one mutex with "not full" and
+ * "not empty" condition variables.
+ */
+class PrintQueue {
+public:
+  PrintQueue() : head(0), count(0), closed(false) {
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&not_full, NULL);
+    pthread_cond_init(&not_empty, NULL);
+  }
+
+  ~PrintQueue() {
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&not_full);
+    pthread_cond_destroy(&not_empty);
+  }
+
+  /**
+   * Add a job, blocking while the queue is full.
+   */
+  void submit(const PrintJob &job) {
+    pthread_mutex_lock(&lock);
+    while (count == QUEUE_CAPACITY)
+      pthread_cond_wait(&not_full, &lock);
+    jobs[(head + count) % QUEUE_CAPACITY] = job;
+    count++;
+    pthread_cond_signal(&not_empty);
+    pthread_mutex_unlock(&lock);
+  }
+
+  /**
+   * Take the next batch: wait for a first job, then up to window_us for the
+   * batch to reach max_batch jobs.
+   * @return The number of jobs taken; 0 once the queue is closed and empty.
+   */
+  int take_batch(PrintJob *batch, int max_batch, long window_us) {
+    pthread_mutex_lock(&lock);
+    // Another printer waiting out its own window may take the jobs first; then start over
+    do {
+      while (count == 0 && !closed)
+        pthread_cond_wait(&not_empty, &lock);
+      if (count < max_batch && window_us > 0 && !closed) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += window_us * 1000;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+        while (count < max_batch && !closed &&
+               pthread_cond_timedwait(&not_empty, &lock, &deadline) == 0)
+          ;
+      }
+    } while (count == 0 && !closed);
+    int taken = std::min(count, max_batch);
+    for (int i = 0; i < taken; i++)
+      batch[i] = jobs[(head + i) % QUEUE_CAPACITY];
+    head = (head + taken) % QUEUE_CAPACITY;
+    count -= taken;
+    if (taken > 0)
+      pthread_cond_broadcast(&not_full); // Several submitters may fit now
+    if (count > 0)
+      pthread_cond_signal(&not_empty); // Leftovers for another printer
+    pthread_mutex_unlock(&lock);
+    return taken;
+  }
+
+  /**
+   * No more jobs will come; printers exit once the queue is empty.
+   */
+  void close() {
+    pthread_mutex_lock(&lock);
+    closed = true;
+    pthread_cond_broadcast(&not_empty);
+    pthread_mutex_unlock(&lock);
+  }
+
+private:
+  PrintJob jobs[QUEUE_CAPACITY];
+  int head, count;
+  bool closed;
+  pthread_mutex_t lock;
+  pthread_cond_t not_full, not_empty;
+};
+
+/**
+ * Print server settings and the results collected by its printers.
+ */
+struct PrintServer {
+  PrintQueue queue;
+  int max_batch;
+  long window_us;
+  std::vector<std::vector<double>> latencies_ms; // One list per printer
+  std::vector<time_point> last_print;            // Per printer
+  std::vector<long> batches;                     // Per printer
+};
+
+struct Printer {
+  PrintServer *server;
+  int id;
+};
+
+/**
+ * Thread function for a printer: take a batch, print it, record latencies.
+ * @param arg Pointer to a Printer.
+ */
+void *printer_activities(void *arg) {
+  Printer *printer = (Printer *)arg;
+  PrintServer *server = printer->server;
+  std::vector<PrintJob> batch(server->max_batch);
+  int taken;
+  while ((taken = server->queue.take_batch(batch.data(), server->max_batch,
+                                           server->window_us)) > 0) {
+    int pages = 0;
+    std::string ids;
+    for (int i = 0; i < taken; i++) {
+      pages += batch[i].pages;
+      ids += (i ? ", " : "") + std::to_string(batch[i].id);
+    }
+    write_output("Printer " + std::to_string(printer->id) +
+                 " started printing " + std::to_string(taken) +
+                 " report(s) (students " + ids + ") at " +
+                 std::to_string(get_time()) + " ms\n");
+    usleep(BATCH_SETUP_TIME + pages * PAGE_TIME); // Simulate printing
+
+    time_point now = std::chrono::steady_clock::now();
+    for (int i = 0; i < taken; i++) {
+      double latency =
+          std::chrono::duration<double, std::milli>(now - batch[i].submitted)
+              .count();
+      server->latencies_ms[printer->id - 1].push_back(latency);
+      write_output("Student " + std::to_string(batch[i].id) +
+                   "'s report was printed by printer " +
+                   std::to_string(printer->id) + " at " +
+                   std::to_string(get_time()) + " ms (" +
+                   std::to_string((long long)latency) + " ms after submitting)\n");
+    }
+    server->last_print[printer->id - 1] = now;
+    server->batches[printer->id - 1]++;
+  }
+  return NULL;
+}
+
+struct Summary {
+  double jobs_per_second;
+  double mean_batch;
+  double p50_ms, p99_ms, max_ms;
+};
+
+/**
+ * Start the printers, run the submitters, close the queue and collect results.
+ * @param submit Function that submits every job, returns when all are in.
+ */
+template <typename Submit>
+Summary run_print_server(int printers, int max_batch, long window_us,
+                         Submit submit) {
+  PrintServer server;
+  server.max_batch = max_batch;
+  server.window_us = window_us;
+  server.latencies_ms.resize(printers);
+  server.last_print.assign(printers, std::chrono::steady_clock::now());
+  server.batches.assign(printers, 0);
+
+  std::vector<pthread_t> printer_threads(printers);
+  std::vector<Printer> printer_info(printers);
+  time_point begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < printers; i++) {
+    printer_info[i] = {&server, i + 1};
+    pthread_create(&printer_threads[i], NULL, printer_activities,
+                   &printer_info[i]);
+  }
+  submit(server.queue);
+  server.queue.close();
+  for (int i = 0; i < printers; i++)
+    pthread_join(printer_threads[i], NULL);
+
+  std::vector<double> all;
+  long batches = 0;
+  time_point end = begin;
+  for (int i = 0; i < printers; i++) {
+    all.insert(all.end(), server.latencies_ms[i].begin(),
+               server.latencies_ms[i].end());
+    batches += server.batches[i];
+    end = std::max(end, server.last_print[i]);
+  }
+  std::sort(all.begin(), all.end());
+  Summary summary = {};
+  if (all.empty())
+    return summary;
+  summary.jobs_per_second =
+      all.size() / std::chrono::duration<double>(end - begin).count();
+  summary.mean_batch = (double)all.size() / batches;
+  summary.p50_ms = all[all.size() / 2];
+  summary.p99_ms = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+  summary.max_ms = all.back();
+  return summary;
+}
+
+/**
+ * Class representing a student in the simulation.
+ */
+class Student {
+public:
+  int id;           // Unique ID for each student
+  int writing_time; // Time student spends "writing"
+  int walking_time; // Time to reach the print station
+  int pages;        // Length of the report
+  PrintQueue *queue;
+
+  Student(int id, std::mt19937 &generator) : id(id), queue(NULL) {
+    writing_time = generator() % MAX_WRITING_TIME + 1;
+    walking_time = generator() % WALKING_TO_PRINTER + 1;
+    pages = generator() % MAX_PAGES + 1;
+  }
+};
+
+/**
+ * Thread function for student activities: write, walk, submit the report.
+ * @param arg Pointer to a Student object.
+ */
+void *student_activities(void *arg) {
+  Student *student = (Student *)arg;
+
+  write_output("Student " + std::to_string(student->id) +
+               " started writing for " + std::to_string(student->writing_time) +
+               " ms at " + std::to_string(get_time()) + " ms\n");
+  usleep(student->writing_time * SLEEP_MULTIPLIER); // Simulate writing time
+  write_output("Student " + std::to_string(student->id) +
+               " finished writing at " + std::to_string(get_time()) + " ms\n");
+  usleep(student->walking_time * SLEEP_MULTIPLIER); // Simulate walking
+
+  write_output("Student " + std::to_string(student->id) +
+               " submitted a " + std::to_string(student->pages) +
+               "-page report at " + std::to_string(get_time()) + " ms\n");
+  student->queue->submit({student->id, student->pages,
+                          std::chrono::steady_clock::now()});
+  return NULL;
+}
+
+/**
+ * Submit `jobs` jobs as Poisson arrivals at `rate` jobs per second.
+ */
+void submit_stream(PrintQueue &queue, int jobs, double rate) {
+  std::mt19937 generator(2024);
+  std::exponential_distribution<double> gap(rate);
+  std::uniform_int_distribution<int> pages(1, MAX_PAGES);
+  time_point scheduled = std::chrono::steady_clock::now();
+  for (int i = 1; i <= jobs; i++) {
+    scheduled += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(gap(generator)));
+    std::this_thread::sleep_until(scheduled);
+    queue.submit({i, pages(generator), scheduled});
+  }
+}
+
+void print_summary(Summary summary) {
+  std::cout << "Throughput: " << summary.jobs_per_second << " jobs/s, "
+            << summary.mean_batch << " jobs per batch" << std::endl;
+  std::cout << "Submit-to-print latency: p50 " << summary.p50_ms << " ms, p99 "
+            << summary.p99_ms << " ms, max " << summary.max_ms << " ms"
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  bool sweep = argc > 1 && strcmp(argv[1], "--sweep") == 0;
+  int printers = 2, max_batch = 4, jobs = 2000;
+  long window_us = 2000;
+  double rate = 2000;
+  bool valid = sweep || argc >= 3;
+  for (int i = sweep ? 2 : 3; i < argc; i++) {
+    std::string option = argv[i];
+    if (!sweep && option.rfind("--printers=", 0) == 0)
+      printers = atoi(argv[i] + 11);
+    else if (!sweep && option.rfind("--batch=", 0) == 0)
+      max_batch = atoi(argv[i] + 8);
+    else if (!sweep && option.rfind("--window-ms=", 0) == 0)
+      window_us = (long)(atof(argv[i] + 12) * 1000);
+    else if (sweep && option.rfind("--jobs=", 0) == 0)
+      jobs = atoi(argv[i] + 7);
+    else if (sweep && option.rfind("--rate=", 0) == 0)
+      rate = atof(argv[i] + 7);
+    else
+      valid = false;
+  }
+  if (!valid || printers <= 0 || max_batch <= 0 || window_us < 0 ||
+      jobs <= 0 || rate <= 0) {
+    std::cout << "Usage: ./a.out <input_file> <output_file> [--printers=K] "
+                 "[--batch=B] [--window-ms=W]\n"
+                 "       ./a.out --sweep [--jobs=N] [--rate=R]"
+              << std::endl;
+    return 0;
+  }
+  pthread_mutex_init(&output_lock, NULL);
+
+  if (sweep) {
+    logging = false;
+    std::cout << jobs << " jobs per configuration offered at " << rate
+              << " jobs/s; printing costs " << BATCH_SETUP_TIME
+              << " us per batch + " << PAGE_TIME << " us per page" << std::endl;
+    printf("%8s %6s %10s %10s %10s %10s %10s %10s\n", "printers", "batch",
+           "window_ms", "jobs/s", "per_batch", "p50_ms", "p99_ms", "max_ms");
+    for (int k : {1, 2, 4})
+      for (int b : {1, 4, 16})
+        for (long w : {0L, 5000L}) {
+          if (b == 1 && w > 0)
+            continue; // A batch of one never waits
+          Summary s = run_print_server(k, b, w, [&](PrintQueue &queue) {
+            submit_stream(queue, jobs, rate);
+          });
+          printf("%8d %6d %10.1f %10.1f %10.2f %10.2f %10.2f %10.2f\n", k, b,
+                 w / 1000.0, s.jobs_per_second, s.mean_batch, s.p50_ms,
+                 s.p99_ms, s.max_ms);
+          fflush(stdout);
+        }
+    return 0;
+  }
+
+  // File handling for input and output redirection
+  std::ifstream inputFile(argv[1]);
+  std::streambuf *cinBuffer = std::cin.rdbuf(); // Save original std::cin buffer
+  std::cin.rdbuf(inputFile.rdbuf()); // Redirect std::cin to input file
+
+  std::ofstream outputFile(argv[2]);
+  std::streambuf *coutBuffer = std::cout.rdbuf(); // Save original cout buffer
+  std::cout.rdbuf(outputFile.rdbuf()); // Redirect cout to output file
+
+  int N; // Number of students
+  std::cin >> N;
+
+  std::mt19937 generator(std::random_device{}());
+  std::vector<Student> students;
+  for (int i = 1; i <= N; i++)
+    students.emplace_back(i, generator);
+  std::vector<pthread_t> student_threads(N);
+
+  start_time = std::chrono::steady_clock::now();
+  Summary summary = run_print_server(
+      printers, max_batch, window_us, [&](PrintQueue &queue) {
+        for (int i = 0; i < N; i++) {
+          students[i].queue = &queue;
+          pthread_create(&student_threads[i], NULL, student_activities,
+                         &students[i]);
+        }
+        for (int i = 0; i < N; i++)
+          pthread_join(student_threads[i], NULL);
+      });
+  std::cout << std::endl
+            << printers << " printer(s), batches of up to " << max_batch
+            << ", " << window_us / 1000.0 << " ms window" << std::endl;
+  print_summary(summary);
+
+  // Restore std::cin and cout to their original states (console)
+  std::cin.rdbuf(cinBuffer);
+  std::cout.rdbuf(coutBuffer);
+
+  return 0;
+}
@@ -0,0 +1,314 @@
+/*
+  This program turns prod_cons_with_mutex.cpp and prod_cons_without_mutex.cpp
+  into a configurable producer-consumer benchmark over the channels in
+  ring_buffer.h.
+
+  How it works:
+    - P producers push N items in total (producer i sends the ids in its own
+  contiguous range) into one channel of the chosen backend and capacity; C
+  consumers pop them. When the producers are done, one end marker per consumer
+  is pushed so every consumer stops; a consumer whose batch holds several
+  markers keeps one and pushes the others back.
+    - Each item carries its id, the time it was pushed and a payload of the
+  requested size filled with a pattern derived from the id.
+    - Consumers count every id they receive and check its payload, so lost,
+  duplicated or torn items are reported: the run is only "verified" if every
+  id was consumed exactly once with an intact payload.
+    - Reported: items per second, enqueue-to-dequeue latency percentiles (of
+  every item, or a regular sample of them for very large N) and CPU
+  utilization from getrusage (CPU seconds per wall second, and as a share of
+  the online CPUs).
+
+  Compilation:
+    g++ -O2 -pthread prod_cons_benchmark.cpp -o a.out
+
+  Usage:
+    ./a.out [--producers=P] [--consumers=C] [--items=N] [--capacity=K]
+            [--payload=BYTES] [--backend=mutex|spsc|mpmc] [--batch=B]
+
+    Defaults: 1 producer, 1 consumer, 1000000 items, capacity 1024, 16-byte
+  payload, mpmc backend, batch 1. The payload is rounded up to 16, 64, 256,
+  1024 or 4096 bytes. spsc needs exactly one producer and one consumer.
+*/
+
+#include "ring_buffer.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+using namespace std;
+
+#define END_MARKER UINT64_MAX
+#define MAX_LATENCY_SAMPLES 2000000
+
+struct Config
+{
+	int producers = 1;
+	int consumers = 1;
+	long items = 1000000;
+	size_t capacity = 1024;
+	size_t payload = 16;
+	string backend = "mpmc";
+	size_t batch = 1;
+};
+
+template <size_t PAYLOAD>
+struct Item
+{
+	uint64_t id;
+	uint64_t pushed_ns;
+	unsigned char payload[PAYLOAD];
+};
+
+static inline uint64_t now_ns()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <size_t PAYLOAD>
+void fill_payload(Item<PAYLOAD> &item)
+{
+	memset(item.payload, (unsigned char)(item.id * 131 + 7), PAYLOAD);
+}
+
+template <size_t PAYLOAD>
+bool payload_intact(const Item<PAYLOAD> &item)
+{
+	unsigned char expected = (unsigned char)(item.id * 131 + 7);
+	for (size_t i = 0; i < PAYLOAD; i++)
+		if (item.payload[i] != expected)
+			return false;
+	return true;
+}
+
+template <typename Channel, size_t PAYLOAD>
+struct Shared
+{
+	Channel *channel;
+	const Config *config;
+	long sample_every;
+	vector<atomic<uint8_t>> *delivered; // Times each id was consumed
+	atomic<long> torn{0};
+	vector<vector<uint64_t>> latencies;
+};
+
+template <typename Channel, size_t PAYLOAD>
+struct Worker
+{
+	Shared<Channel, PAYLOAD> *shared;
+	int index;
+};
+
+template <typename Channel, size_t PAYLOAD>
+void *producer(void *arg)
+{
+	Worker<Channel, PAYLOAD> *worker = (Worker<Channel, PAYLOAD> *)arg;
+	Shared<Channel, PAYLOAD> *shared = worker->shared;
+	const Config &config = *shared->config;
+	long first = config.items * worker->index / config.producers;
+	long last = config.items * (worker->index + 1) / config.producers;
+	vector<Item<PAYLOAD>> items(config.batch);
+	for (long id = first; id < last;)
+	{
+		size_t n = min((long)config.batch, last - id);
+		for (size_t i = 0; i < n; i++)
+		{
+			items[i].id = id + i;
+			fill_payload(items[i]);
+			items[i].pushed_ns = now_ns();
+		}
+		if (n == 1)
+			shared->channel->push(items[0]);
+		else
+			for (size_t done = 0; done < n;)
+				done += shared->channel->push_batch(items.data() + done, n - done);
+		id += n;
+	}
+	return NULL;
+}
+
+template <typename Channel, size_t PAYLOAD>
+void *consumer(void *arg)
+{
+	Worker<Channel, PAYLOAD> *worker = (Worker<Channel, PAYLOAD> *)arg;
+	Shared<Channel, PAYLOAD> *shared = worker->shared;
+	vector<uint64_t> &latencies = shared->latencies[worker->index];
+	vector<Item<PAYLOAD>> items(shared->config->batch);
+	while (true)
+	{
+		size_t n;
+		if (items.size() == 1)
+			shared->channel->pop(items[0]), n = 1;
+		else
+			n = shared->channel->pop_batch(items.data(), items.size());
+		uint64_t now = now_ns();
+		size_t markers = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const Item<PAYLOAD> &item = items[i];
+			if (item.id == END_MARKER)
+			{
+				markers++; // Markers come after every real item
+				continue;
+			}
+			if ((long)item.id % shared->sample_every == 0)
+				latencies.push_back(now - item.pushed_ns);
+			if (item.id < shared->delivered->size())
+				(*shared->delivered)[item.id].fetch_add(1, memory_order_relaxed);
+			if (!payload_intact(item))
+				shared->torn.fetch_add(1, memory_order_relaxed);
+		}
+		if (markers > 0)
+		{
+			// Each consumer keeps one marker; a batch that grabbed more hands the rest back
+			// for the consumers still waiting
+			Item<PAYLOAD> marker;
+			marker.id = END_MARKER;
+			marker.pushed_ns = 0;
+			for (size_t i = 1; i < markers; i++)
+				shared->channel->push(marker);
+			return NULL;
+		}
+	}
+}
+
+double cpu_seconds()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+template <typename Channel, size_t PAYLOAD>
+bool run(const Config &config)
+{
+	Channel channel(config.capacity);
+	vector<atomic<uint8_t>> delivered(config.items);
+	for (auto &count : delivered)
+		count.store(0, memory_order_relaxed);
+	Shared<Channel, PAYLOAD> shared;
+	shared.channel = &channel;
+	shared.config = &config;
+	shared.sample_every = max(1L, config.items / MAX_LATENCY_SAMPLES);
+	shared.delivered = &delivered;
+	shared.latencies.resize(config.consumers);
+
+	vector<pthread_t> producers(config.producers), consumers(config.consumers);
+	vector<Worker<Channel, PAYLOAD>> workers(config.producers + config.consumers);
+	double cpu_begin = cpu_seconds();
+	uint64_t begin = now_ns();
+	for (int i = 0; i < config.consumers; i++)
+	{
+		workers[i] = {&shared, i};
+		pthread_create(&consumers[i], NULL, consumer<Channel, PAYLOAD>, &workers[i]);
+	}
+	for (int i = 0; i < config.producers; i++)
+	{
+		workers[config.consumers + i] = {&shared, i};
+		pthread_create(&producers[i], NULL, producer<Channel, PAYLOAD>, &workers[config.consumers + i]);
+	}
+	for (pthread_t &thread : producers)
+		pthread_join(thread, NULL);
+	Item<PAYLOAD> marker;
+	marker.id = END_MARKER;
+	marker.pushed_ns = 0;
+	for (int i = 0; i < config.consumers; i++)
+		channel.push(marker);
+	for (pthread_t &thread : consumers)
+		pthread_join(thread, NULL);
+	double seconds = (now_ns() - begin) / 1e9;
+	double cpu = cpu_seconds() - cpu_begin;
+
+	long missing = 0, duplicated = 0;
+	for (auto &count : delivered)
+	{
+		uint8_t times = count.load(memory_order_relaxed);
+		missing += times == 0;
+		duplicated += times > 1;
+	}
+	vector<uint64_t> all;
+	for (auto &samples : shared.latencies)
+		all.insert(all.end(), samples.begin(), samples.end());
+	sort(all.begin(), all.end());
+	auto percentile = [&](double p)
+	{ return all.empty() ? 0.0 : all[min(all.size() - 1, (size_t)(p * all.size()))] / 1000.0; };
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	printf("backend %s, %d producers, %d consumers, %ld items, capacity %zu, payload %zu bytes, batch %zu\n",
+		   config.backend.c_str(), config.producers, config.consumers, config.items, config.capacity, PAYLOAD, config.batch);
+	printf("throughput: %.0f items/s (%.1f MB/s of payload) in %.3f s\n", config.items / seconds,
+		   config.items * (double)PAYLOAD / seconds / 1e6, seconds);
+	printf("latency (us, %zu samples): p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, max %.2f\n", all.size(),
+		   percentile(0.50), percentile(0.90), percentile(0.99), percentile(0.999), all.empty() ? 0.0 : all.back() / 1000.0);
+	printf("cpu: %.3f s, %.2f CPUs busy, %.1f%% of %ld online CPUs\n", cpu, cpu / seconds, 100 * cpu / seconds / cpus, cpus);
+	bool verified = missing == 0 && duplicated == 0 && shared.torn == 0;
+	printf("exactly-once: %s (%ld missing, %ld duplicated, %ld torn payloads)\n", verified ? "verified" : "FAILED",
+		   missing, duplicated, shared.torn.load());
+	return verified;
+}
+
+template <size_t PAYLOAD>
+bool run_backend(const Config &config)
+{
+	if (config.backend == "mutex")
+		return run<MutexSemQueue<Item<PAYLOAD>>, PAYLOAD>(config);
+	if (config.backend == "spsc")
+		return run<SpscRing<Item<PAYLOAD>>, PAYLOAD>(config);
+	return run<MpmcRing<Item<PAYLOAD>>, PAYLOAD>(config);
+}
+
+int main(int argc, char *argv[])
+{
+	Config config;
+	bool valid = true;
+	for (int i = 1; i < argc; i++)
+	{
+		string option = argv[i];
+		size_t equals = option.find('=');
+		string name = option.substr(0, equals), value = equals == string::npos ? "" : option.substr(equals + 1);
+		if (name == "--producers")
+			config.producers = atoi(value.c_str());
+		else if (name == "--consumers")
+			config.consumers = atoi(value.c_str());
+		else if (name == "--items")
+			config.items = atol(value.c_str());
+		else if (name == "--capacity")
+			config.capacity = atol(value.c_str());
+		else if (name == "--payload")
+			config.payload = atol(value.c_str());
+		else if (name == "--backend")
+			config.backend = value;
+		else if (name == "--batch")
+			config.batch = atol(value.c_str());
+		else
+			valid = false;
+	}
+	valid = valid && config.producers > 0 && config.consumers > 0 && config.items > 0 && config.capacity > 0 &&
+			config.batch > 0 && config.payload <= 4096 &&
+			(config.backend == "mutex" || config.backend == "spsc" || config.backend == "mpmc") &&
+			(config.backend != "spsc" || (config.producers == 1 && config.consumers == 1));
+	if (!valid)
+	{
+		printf("Usage: ./a.out [--producers=P] [--consumers=C] [--items=N] [--capacity=K]\n"
+			   "               [--payload=BYTES] [--backend=mutex|spsc|mpmc] [--batch=B]\n"
+			   "(spsc needs one producer and one consumer; payload at most 4096 bytes)\n");
+		return 0;
+	}
+
+	bool verified;
+	if (config.payload <= 16)
+		verified = run_backend<16>(config);
+	else if (config.payload <= 64)
+		verified = run_backend<64>(config);
+	else if (config.payload <= 256)
+		verified = run_backend<256>(config);
+	else if (config.payload <= 1024)
+		verified = run_backend<1024>(config);
+	else
+		verified = run_backend<4096>(config);
+	return verified ? 0 : 1;
+}
@@ -0,0 +1,397 @@
+/*
+  Bounded producer-consumer channels, from the textbook version in
+  prod_cons_with_mutex.cpp to lock-free ring buffers.
+
+  Channels (all have the same interface):
+    - MutexSemQueue: std::queue guarded by a mutex, with sem_empty/sem_full
+      counting free and used slots, as in prod_cons_with_mutex.cpp.
+    - SpscRing: single producer, single consumer. Head and tail live on their
+      own cache lines and each side caches the other's index, so the shared
+      lines are only touched when the cached view runs out.
+    - MpmcRing: any number of producers and consumers (Dmitry Vyukov's bounded
+      queue). Every cell carries a sequence number that says whether it is
+      free or full for the current lap, so a push or pop is one CAS on the
+      shared index plus one store to the cell.
+
+  Interface:
+    try_push(item) / try_pop(item)            non-blocking, false if full / empty
+    push(item) / pop(item)                    block while full / empty
+    push_batch(items, n) / pop_batch(items, n)
+        block until at least one item moves, then move as many as possible (up
+        to n) and return how many; the ring versions claim the whole run of
+        cells with a single index update
+
+  Blocking uses futexes only when a thread really has to wait: a waiter spins
+  briefly, then registers itself and sleeps on a futex word, and the other
+  side only makes a wake-up system call if someone is registered.
+
+  Capacities of the ring buffers are rounded up to a power of two.
+*/
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <queue>
+#include <semaphore.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define CACHE_LINE 64
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+static inline size_t round_up_pow2(size_t n)
+{
+	size_t capacity = 1;
+	while (capacity < n)
+		capacity <<= 1;
+	return capacity;
+}
+
+// Sleep/wake-up point for one condition ("not empty" or "not full")
+class FutexWaiter
+{
+public:
+	// Returns once ready() is true; ready() may have side effects (e.g. a try_push)
+	template <typename Ready>
+	void wait(Ready ready)
+	{
+		for (int spin = 0; spin < SPINS; spin++)
+		{
+			if (ready())
+				return;
+			cpu_relax();
+		}
+		while (true)
+		{
+			uint32_t seen = epoch.load(std::memory_order_acquire);
+			sleepers.fetch_add(1, std::memory_order_seq_cst);
+			if (ready())
+				return; // Stays registered; costs at most one spare wake-up call later
+			syscall(SYS_futex, (uint32_t *)&epoch, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+		}
+	}
+
+	// Called after the condition may have become true
+	void notify()
+	{
+		// Pairs with the waiter's seq_cst registration: either it sees our change or we see it.
+		// Taking all registrations at once means one system call per sleep, not one per item
+		// until the sleeper gets to run.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleepers.load(std::memory_order_relaxed) > 0 && sleepers.exchange(0, std::memory_order_acq_rel) > 0)
+		{
+			epoch.fetch_add(1, std::memory_order_release);
+			syscall(SYS_futex, (uint32_t *)&epoch, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+		}
+	}
+
+private:
+	static const int SPINS = 64;
+	alignas(CACHE_LINE) std::atomic<uint32_t> epoch{0};
+	std::atomic<uint32_t> sleepers{0};
+};
+
+// Shared blocking wrappers; Channel supplies try_push/try_pop/try_push_batch/try_pop_batch
+template <typename Channel, typename T>
+class BlockingChannel
+{
+public:
+	void push(const T &item)
+	{
+		Channel &self = static_cast<Channel &>(*this);
+		if (!self.try_push(item))
+			not_full.wait([&] { return self.try_push(item); });
+		not_empty.notify();
+	}
+
+	void pop(T &item)
+	{
+		Channel &self = static_cast<Channel &>(*this);
+		if (!self.try_pop(item))
+			not_empty.wait([&] { return self.try_pop(item); });
+		not_full.notify();
+	}
+
+	size_t push_batch(const T *items, size_t n)
+	{
+		Channel &self = static_cast<Channel &>(*this);
+		size_t moved = self.try_push_batch(items, n);
+		if (moved == 0)
+			not_full.wait([&] { return (moved = self.try_push_batch(items, n)) > 0; });
+		not_empty.notify();
+		return moved;
+	}
+
+	size_t pop_batch(T *items, size_t n)
+	{
+		Channel &self = static_cast<Channel &>(*this);
+		size_t moved = self.try_pop_batch(items, n);
+		if (moved == 0)
+			not_empty.wait([&] { return (moved = self.try_pop_batch(items, n)) > 0; });
+		not_full.notify();
+		return moved;
+	}
+
+private:
+	FutexWaiter not_empty;
+	FutexWaiter not_full;
+};
+
+// The prod_cons_with_mutex.cpp scheme, without the sleep inside the critical section
+template <typename T>
+class MutexSemQueue
+{
+public:
+	explicit MutexSemQueue(size_t capacity)
+	{
+		sem_init(&sem_empty, 0, capacity);
+		sem_init(&sem_full, 0, 0);
+		pthread_mutex_init(&lock, NULL);
+	}
+
+	~MutexSemQueue()
+	{
+		sem_destroy(&sem_empty);
+		sem_destroy(&sem_full);
+		pthread_mutex_destroy(&lock);
+	}
+
+	bool try_push(const T &item)
+	{
+		if (sem_trywait(&sem_empty) != 0)
+			return false;
+		locked_push(item);
+		return true;
+	}
+
+	bool try_pop(T &item)
+	{
+		if (sem_trywait(&sem_full) != 0)
+			return false;
+		locked_pop(item);
+		return true;
+	}
+
+	void push(const T &item)
+	{
+		sem_wait(&sem_empty);
+		locked_push(item);
+	}
+
+	void pop(T &item)
+	{
+		sem_wait(&sem_full);
+		locked_pop(item);
+	}
+
+	// A semaphore has no "take up to n", so the batch waits for one slot and then takes what it can
+	size_t push_batch(const T *items, size_t n)
+	{
+		size_t moved = 0;
+		sem_wait(&sem_empty);
+		pthread_mutex_lock(&lock);
+		do
+		{
+			q.push(items[moved++]);
+		} while (moved < n && sem_trywait(&sem_empty) == 0);
+		pthread_mutex_unlock(&lock);
+		for (size_t i = 0; i < moved; i++)
+			sem_post(&sem_full);
+		return moved;
+	}
+
+	size_t pop_batch(T *items, size_t n)
+	{
+		size_t moved = 0;
+		sem_wait(&sem_full);
+		pthread_mutex_lock(&lock);
+		do
+		{
+			items[moved++] = q.front();
+			q.pop();
+		} while (moved < n && sem_trywait(&sem_full) == 0);
+		pthread_mutex_unlock(&lock);
+		for (size_t i = 0; i < moved; i++)
+			sem_post(&sem_empty);
+		return moved;
+	}
+
+private:
+	void locked_push(const T &item)
+	{
+		pthread_mutex_lock(&lock);
+		q.push(item);
+		pthread_mutex_unlock(&lock);
+		sem_post(&sem_full);
+	}
+
+	void locked_pop(T &item)
+	{
+		pthread_mutex_lock(&lock);
+		item = q.front();
+		q.pop();
+		pthread_mutex_unlock(&lock);
+		sem_post(&sem_empty);
+	}
+
+	sem_t sem_empty;
+	sem_t sem_full;
+	pthread_mutex_t lock;
+	std::queue<T> q;
+};
+
+template <typename T>
+class SpscRing : public BlockingChannel<SpscRing<T>, T>
+{
+public:
+	explicit SpscRing(size_t capacity) : mask(round_up_pow2(capacity) - 1), cells(new T[mask + 1]) {}
+	~SpscRing() { delete[] cells; }
+
+	bool try_push(const T &item) { return try_push_batch(&item, 1) == 1; }
+	bool try_pop(T &item) { return try_pop_batch(&item, 1) == 1; }
+
+	size_t try_push_batch(const T *items, size_t n)
+	{
+		size_t tail = producer.index.load(std::memory_order_relaxed);
+		size_t free_cells = mask + 1 - (tail - producer.cached_other);
+		if (free_cells < n)
+		{
+			producer.cached_other = consumer.index.load(std::memory_order_acquire);
+			free_cells = mask + 1 - (tail - producer.cached_other);
+		}
+		n = n < free_cells ? n : free_cells;
+		for (size_t i = 0; i < n; i++)
+			cells[(tail + i) & mask] = items[i];
+		producer.index.store(tail + n, std::memory_order_release);
+		return n;
+	}
+
+	size_t try_pop_batch(T *items, size_t n)
+	{
+		size_t head = consumer.index.load(std::memory_order_relaxed);
+		size_t full_cells = consumer.cached_other - head;
+		if (full_cells < n)
+		{
+			consumer.cached_other = producer.index.load(std::memory_order_acquire);
+			full_cells = consumer.cached_other - head;
+		}
+		n = n < full_cells ? n : full_cells;
+		for (size_t i = 0; i < n; i++)
+			items[i] = cells[(head + i) & mask];
+		consumer.index.store(head + n, std::memory_order_release);
+		return n;
+	}
+
+private:
+	// Own index, and the last value seen of the other side's index
+	struct alignas(CACHE_LINE) Side
+	{
+		std::atomic<size_t> index{0};
+		size_t cached_other = 0;
+	};
+
+	const size_t mask;
+	T *const cells;
+	Side producer;
+	Side consumer;
+};
+
+template <typename T>
+class MpmcRing : public BlockingChannel<MpmcRing<T>, T>
+{
+public:
+	explicit MpmcRing(size_t capacity) : mask(round_up_pow2(capacity) - 1), cells(new Cell[mask + 1])
+	{
+		for (size_t i = 0; i <= mask; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	~MpmcRing() { delete[] cells; }
+
+	bool try_push(const T &item) { return try_push_batch(&item, 1) == 1; }
+	bool try_pop(T &item) { return try_pop_batch(&item, 1) == 1; }
+
+	// Claims the longest run of free cells (up to n) starting at the enqueue position
+	size_t try_push_batch(const T *items, size_t n)
+	{
+		size_t position = enqueue_position.load(std::memory_order_relaxed);
+		while (true)
+		{
+			size_t run = 0;
+			while (run < n && cells[(position + run) & mask].sequence.load(std::memory_order_acquire) == position + run)
+				run++;
+			if (run == 0)
+			{
+				intptr_t lag = (intptr_t)(cells[position & mask].sequence.load(std::memory_order_acquire) - position);
+				if (lag < 0)
+					return 0; // Full: the cell still holds last lap's item
+				position = enqueue_position.load(std::memory_order_relaxed);
+				continue;
+			}
+			if (enqueue_position.compare_exchange_weak(position, position + run, std::memory_order_relaxed))
+			{
+				for (size_t i = 0; i < run; i++)
+				{
+					Cell &cell = cells[(position + i) & mask];
+					cell.data = items[i];
+					cell.sequence.store(position + i + 1, std::memory_order_release);
+				}
+				return run;
+			}
+		}
+	}
+
+	size_t try_pop_batch(T *items, size_t n)
+	{
+		size_t position = dequeue_position.load(std::memory_order_relaxed);
+		while (true)
+		{
+			size_t run = 0;
+			while (run < n && cells[(position + run) & mask].sequence.load(std::memory_order_acquire) == position + run + 1)
+				run++;
+			if (run == 0)
+			{
+				intptr_t lag = (intptr_t)(cells[position & mask].sequence.load(std::memory_order_acquire) - (position + 1));
+				if (lag < 0)
+					return 0; // Empty: the cell has not been written this lap
+				position = dequeue_position.load(std::memory_order_relaxed);
+				continue;
+			}
+			if (dequeue_position.compare_exchange_weak(position, position + run, std::memory_order_relaxed))
+			{
+				for (size_t i = 0; i < run; i++)
+				{
+					Cell &cell = cells[(position + i) & mask];
+					items[i] = cell.data;
+					cell.sequence.store(position + i + mask + 1, std::memory_order_release);
+				}
+				return run;
+			}
+		}
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	const size_t mask;
+	Cell *const cells;
+	alignas(CACHE_LINE) std::atomic<size_t> enqueue_position{0};
+	alignas(CACHE_LINE) std::atomic<size_t> dequeue_position{0};
+};
+
+#endif
@@ -0,0 +1,235 @@
+/*
+  This program compares the channels in ring_buffer.h: the mutex + semaphore
+  queue of prod_cons_with_mutex.cpp against the SPSC and MPMC lock-free ring
+  buffers, with and without batching.
+
+  How it works:
+    - P producers push items into one channel and C consumers pop them, for
+  1-1, 4-4 and 16-16 producer/consumer counts (SPSC only runs 1-1).
+    - Every item carries a unique id and the time it was pushed; consumers
+  record the push-to-pop latency of every 16th id.
+    - When the producers are done, one end marker per consumer is pushed, so a
+  lost item cannot stall the run.
+    - Throughput is total items over wall time. Latency percentiles are taken
+  over all recorded samples. Every id is counted as it is consumed, and the
+  last column reports ids that never arrived or arrived more than once.
+
+  Compilation:
+    g++ -O2 -pthread ring_buffer_benchmark.cpp -o a.out
+
+  Usage:
+    ./a.out [items] [capacity] [batch]
+
+    items defaults to 2000000 per configuration, capacity to 1024 and the batch
+  size of the batched runs to 32.
+*/
+
+#include "ring_buffer.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+using namespace std;
+
+#define SAMPLE_EVERY 16
+
+struct Item
+{
+	uint64_t id;
+	uint64_t pushed_ns;
+};
+
+static const uint64_t END_MARKER = numeric_limits<uint64_t>::max();
+
+static inline uint64_t now_ns()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result
+{
+	double items_per_second;
+	double p50_us;
+	double p99_us;
+	long missing;
+	long duplicated;
+};
+
+template <typename Channel>
+struct Run
+{
+	Channel *channel;
+	long items_per_producer;
+	size_t batch;
+	vector<atomic<uint8_t>> *delivered; // Times each id was consumed
+	vector<vector<uint64_t>> latencies; // One per consumer
+};
+
+template <typename Channel>
+struct Worker
+{
+	Run<Channel> *run;
+	int index;
+};
+
+template <typename Channel>
+void *producer(void *arg)
+{
+	Worker<Channel> *worker = (Worker<Channel> *)arg;
+	Run<Channel> *run = worker->run;
+	long first = run->items_per_producer * worker->index;
+	long last = first + run->items_per_producer;
+	vector<Item> items(run->batch);
+	for (long id = first; id < last;)
+	{
+		if (run->batch == 1)
+		{
+			run->channel->push(Item{(uint64_t)id, now_ns()});
+			id++;
+			continue;
+		}
+		size_t n = min((long)run->batch, last - id);
+		uint64_t stamp = now_ns();
+		for (size_t i = 0; i < n; i++)
+			items[i] = Item{(uint64_t)(id + i), stamp};
+		for (size_t done = 0; done < n;)
+			done += run->channel->push_batch(items.data() + done, n - done);
+		id += n;
+	}
+	return NULL;
+}
+
+template <typename Channel>
+void *consumer(void *arg)
+{
+	Worker<Channel> *worker = (Worker<Channel> *)arg;
+	Run<Channel> *run = worker->run;
+	vector<uint64_t> &latencies = run->latencies[worker->index];
+	vector<Item> items(run->batch);
+	while (true)
+	{
+		size_t n;
+		if (run->batch == 1)
+			run->channel->pop(items[0]), n = 1;
+		else
+			n = run->channel->pop_batch(items.data(), run->batch);
+		uint64_t now = now_ns();
+		size_t markers = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			if (items[i].id == END_MARKER)
+			{
+				markers++; // Markers come after every real item
+				continue;
+			}
+			if (items[i].id % SAMPLE_EVERY == 0)
+				latencies.push_back(now - items[i].pushed_ns);
+			if (items[i].id < run->delivered->size())
+				(*run->delivered)[items[i].id].fetch_add(1, memory_order_relaxed);
+		}
+		if (markers > 0)
+		{
+			// Keep one marker and hand any extra back to the consumers still waiting
+			for (size_t i = 1; i < markers; i++)
+				run->channel->push(Item{END_MARKER, 0});
+			return NULL;
+		}
+	}
+}
+
+template <typename Channel>
+Result measure(int producers, int consumers, long items, size_t capacity, size_t batch)
+{
+	Channel channel(capacity);
+	Run<Channel> run;
+	run.channel = &channel;
+	run.items_per_producer = items / producers;
+	run.batch = batch;
+	vector<atomic<uint8_t>> delivered(run.items_per_producer * producers);
+	for (auto &count : delivered)
+		count.store(0, memory_order_relaxed);
+	run.delivered = &delivered;
+	run.latencies.resize(consumers);
+
+	vector<pthread_t> threads(producers + consumers);
+	vector<Worker<Channel>> workers(producers + consumers);
+	uint64_t begin = now_ns();
+	for (int i = 0; i < consumers; i++)
+	{
+		workers[i] = {&run, i};
+		pthread_create(&threads[i], NULL, consumer<Channel>, &workers[i]);
+	}
+	for (int i = 0; i < producers; i++)
+	{
+		workers[consumers + i] = {&run, i};
+		pthread_create(&threads[consumers + i], NULL, producer<Channel>, &workers[consumers + i]);
+	}
+	for (int i = 0; i < producers; i++)
+		pthread_join(threads[consumers + i], NULL);
+	for (int i = 0; i < consumers; i++)
+		channel.push(Item{END_MARKER, 0});
+	for (int i = 0; i < consumers; i++)
+		pthread_join(threads[i], NULL);
+	double seconds = (now_ns() - begin) / 1e9;
+
+	Result result;
+	result.missing = result.duplicated = 0;
+	for (auto &count : delivered)
+	{
+		uint8_t times = count.load(memory_order_relaxed);
+		result.missing += times == 0;
+		result.duplicated += times > 1;
+	}
+	vector<uint64_t> all;
+	for (auto &samples : run.latencies)
+		all.insert(all.end(), samples.begin(), samples.end());
+	sort(all.begin(), all.end());
+	result.items_per_second = (delivered.size() - result.missing) / seconds;
+	result.p50_us = all.empty() ? 0 : all[all.size() / 2] / 1000.0;
+	result.p99_us = all.empty() ? 0 : all[all.size() * 99 / 100] / 1000.0;
+	return result;
+}
+
+void print(const char *name, int producers, int consumers, size_t batch, Result result)
+{
+	printf("%-16s %3d-%-3d %5zu %12.2f %10.2f %10.2f ", name, producers, consumers, batch,
+		   result.items_per_second / 1e6, result.p50_us, result.p99_us);
+	if (result.missing == 0 && result.duplicated == 0)
+		printf("ok\n");
+	else
+		printf("%ld missing, %ld duplicated\n", result.missing, result.duplicated);
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	long items = argc > 1 ? atol(argv[1]) : 2000000;
+	size_t capacity = argc > 2 ? atol(argv[2]) : 1024;
+	size_t batch = argc > 3 ? atol(argv[3]) : 32;
+	if (items <= 0 || capacity == 0 || batch == 0)
+	{
+		printf("Usage: ./a.out [items] [capacity] [batch]\n");
+		return 0;
+	}
+
+	printf("%ld items per run, capacity %zu, %ld online CPUs\n", items, capacity, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%-16s %7s %5s %12s %10s %10s\n", "channel", "P-C", "batch", "Mitems/s", "p50_us", "p99_us");
+	int counts[] = {1, 4, 16};
+	for (int count : counts)
+	{
+		// Items must split evenly over producers
+		long n = items / count * count;
+		print("mutex+semaphore", count, count, 1, measure<MutexSemQueue<Item>>(count, count, n, capacity, 1));
+		print("mutex+semaphore", count, count, batch, measure<MutexSemQueue<Item>>(count, count, n, capacity, batch));
+		if (count == 1)
+		{
+			print("spsc ring", 1, 1, 1, measure<SpscRing<Item>>(1, 1, n, capacity, 1));
+			print("spsc ring", 1, 1, batch, measure<SpscRing<Item>>(1, 1, n, capacity, batch));
+		}
+		print("mpmc ring", count, count, 1, measure<MpmcRing<Item>>(count, count, n, capacity, 1));
+		print("mpmc ring", count, count, batch, measure<MpmcRing<Item>>(count, count, n, capacity, batch));
+	}
+	return 0;
+}
@@ -0,0 +1,499 @@
+/*
+  This program measures how fast one thread can wake another with each of the
+  blocking primitives used in this course (and a few lower-level ones), so the
+  simulations can pick a primitive from numbers instead of guesses.
+
+  How it works:
+    - Each primitive is wrapped as a one-way Signal with post() and wait();
+  wait() returns once per post(), like a counting semaphore:
+      sem         sem_t (semaphore.c)
+      mutex+cond  a counter under a pthread mutex with a condition variable
+      futex       an atomic counter, FUTEX_WAIT when it is zero and FUTEX_WAKE
+                  on every post
+      eventfd     an eventfd in semaphore mode (read takes one, write adds one)
+      pipe        one byte written per post, read per wait
+      spin        an atomic counter polled in a busy loop
+      spin+yield  the same, but sched_yield() after a short spin
+    - Ping-pong: thread A posts "ping" and waits for "pong"; thread B does the
+  opposite. Every round trip is timed; the table shows the median and 99th
+  percentile round trip and round trips per second.
+    - Placement: both threads pinned to one CPU, to two hardware threads of
+  one core, to two cores of one socket, to two sockets, or not pinned. The
+  pairs come from the topology directory of every CPU in sysfs; a placement the
+  machine does not have is reported as skipped.
+    - Handoff ring: T unpinned threads pass a token around a ring (thread i
+  waits on signal i and posts signal i+1); the table shows handoffs per second.
+    - Every test runs for a fixed time, so slow combinations (pure spinning
+  with both threads on one CPU waits for the scheduler's time slice) finish
+  too, they just do few rounds.
+
+  Compilation:
+    g++ -O2 -pthread sync_latency.cpp -o a.out
+
+  Usage:
+    ./a.out [seconds_per_test] [ring_threads]
+
+    seconds_per_test defaults to 0.3 and ring_threads to 8.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+#define SPINS_BEFORE_YIELD 100
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+static inline uint64_t now_ns()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------------------------------------------------------------------------
+// Signals: post() makes exactly one wait() return
+// ---------------------------------------------------------------------------
+class Signal
+{
+public:
+	virtual ~Signal() {}
+	virtual void post() = 0;
+	virtual void wait() = 0;
+};
+
+class SemSignal : public Signal
+{
+public:
+	SemSignal() { sem_init(&sem, 0, 0); }
+	~SemSignal() { sem_destroy(&sem); }
+	void post() { sem_post(&sem); }
+	void wait()
+	{
+		while (sem_wait(&sem) != 0)
+			; // EINTR
+	}
+
+private:
+	sem_t sem;
+};
+
+class CondSignal : public Signal
+{
+public:
+	CondSignal()
+	{
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&cond, NULL);
+	}
+	~CondSignal()
+	{
+		pthread_mutex_destroy(&lock);
+		pthread_cond_destroy(&cond);
+	}
+	void post()
+	{
+		pthread_mutex_lock(&lock);
+		count++;
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+	void wait()
+	{
+		pthread_mutex_lock(&lock);
+		while (count == 0)
+			pthread_cond_wait(&cond, &lock);
+		count--;
+		pthread_mutex_unlock(&lock);
+	}
+
+private:
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	long count = 0;
+};
+
+class FutexSignal : public Signal
+{
+public:
+	void post()
+	{
+		count.fetch_add(1, memory_order_release);
+		syscall(SYS_futex, (uint32_t *)&count, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	}
+	void wait()
+	{
+		while (true)
+		{
+			uint32_t value = count.load(memory_order_acquire);
+			if (value > 0)
+			{
+				if (count.compare_exchange_weak(value, value - 1, memory_order_acquire))
+					return;
+				continue;
+			}
+			syscall(SYS_futex, (uint32_t *)&count, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+		}
+	}
+
+private:
+	atomic<uint32_t> count{0};
+};
+
+class EventfdSignal : public Signal
+{
+public:
+	EventfdSignal() { fd = eventfd(0, EFD_SEMAPHORE); }
+	~EventfdSignal() { close(fd); }
+	void post()
+	{
+		uint64_t one = 1;
+		while (write(fd, &one, sizeof(one)) != sizeof(one))
+			;
+	}
+	void wait()
+	{
+		uint64_t value;
+		while (read(fd, &value, sizeof(value)) != sizeof(value))
+			;
+	}
+
+private:
+	int fd;
+};
+
+class PipeSignal : public Signal
+{
+public:
+	PipeSignal()
+	{
+		if (pipe(fds) != 0)
+			fds[0] = fds[1] = -1;
+	}
+	~PipeSignal()
+	{
+		close(fds[0]);
+		close(fds[1]);
+	}
+	void post()
+	{
+		char byte = 1;
+		while (write(fds[1], &byte, 1) != 1)
+			;
+	}
+	void wait()
+	{
+		char byte;
+		while (read(fds[0], &byte, 1) != 1)
+			;
+	}
+
+private:
+	int fds[2];
+};
+
+class SpinSignal : public Signal
+{
+public:
+	explicit SpinSignal(bool yield) : yield(yield) {}
+	void post() { count.fetch_add(1, memory_order_release); }
+	void wait()
+	{
+		for (int spin = 0;; spin++)
+		{
+			long value = count.load(memory_order_acquire);
+			if (value > 0 && count.compare_exchange_weak(value, value - 1, memory_order_acquire))
+				return;
+			if (yield && spin >= SPINS_BEFORE_YIELD)
+				sched_yield();
+			else
+				cpu_relax();
+		}
+	}
+
+private:
+	alignas(64) atomic<long> count{0};
+	bool yield;
+};
+
+const char *primitives[] = {"sem", "mutex+cond", "futex", "eventfd", "pipe", "spin", "spin+yield"};
+const int PRIMITIVE_COUNT = sizeof(primitives) / sizeof(primitives[0]);
+
+Signal *make_signal(int primitive)
+{
+	switch (primitive)
+	{
+	case 0:
+		return new SemSignal();
+	case 1:
+		return new CondSignal();
+	case 2:
+		return new FutexSignal();
+	case 3:
+		return new EventfdSignal();
+	case 4:
+		return new PipeSignal();
+	case 5:
+		return new SpinSignal(false);
+	default:
+		return new SpinSignal(true);
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Placement: which two CPUs the ping-pong threads run on
+// ---------------------------------------------------------------------------
+struct Cpu
+{
+	int id, package, core;
+};
+
+vector<Cpu> online_cpus()
+{
+	vector<Cpu> cpus;
+	cpu_set_t allowed;
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	for (int id = 0; id < CPU_SETSIZE; id++)
+	{
+		if (!CPU_ISSET(id, &allowed))
+			continue;
+		string base = "/sys/devices/system/cpu/cpu" + to_string(id) + "/topology/";
+		ifstream package_file(base + "physical_package_id"), core_file(base + "core_id");
+		Cpu cpu = {id, 0, id};
+		if (!(package_file >> cpu.package) || !(core_file >> cpu.core))
+			cpu.package = 0, cpu.core = id; // No topology: treat every CPU as its own core
+		cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+struct Placement
+{
+	const char *name;
+	int cpu_a, cpu_b; // -1: not pinned
+	bool available;
+};
+
+vector<Placement> placements(const vector<Cpu> &cpus)
+{
+	Placement same_cpu = {"same CPU", -1, -1, false}, smt = {"SMT siblings", -1, -1, false};
+	Placement same_socket = {"same socket", -1, -1, false}, cross_socket = {"cross socket", -1, -1, false};
+	if (!cpus.empty())
+		same_cpu = {same_cpu.name, cpus[0].id, cpus[0].id, true};
+	for (const Cpu &a : cpus)
+		for (const Cpu &b : cpus)
+		{
+			if (a.id >= b.id)
+				continue;
+			Placement *match = a.package != b.package ? &cross_socket : a.core == b.core ? &smt : &same_socket;
+			if (!match->available)
+				*match = {match->name, a.id, b.id, true};
+		}
+	return {same_cpu, smt, same_socket, cross_socket, {"not pinned", -1, -1, true}};
+}
+
+// ---------------------------------------------------------------------------
+// Ping-pong
+// ---------------------------------------------------------------------------
+struct PingPong
+{
+	Signal *ping, *pong;
+	double seconds;
+	atomic<bool> stop{false};
+	vector<uint64_t> round_trips;
+};
+
+void *ping_side(void *arg)
+{
+	PingPong *test = (PingPong *)arg;
+	uint64_t begin = now_ns(), deadline = begin + (uint64_t)(test->seconds * 1e9);
+	for (uint64_t sent = now_ns(); sent < deadline;)
+	{
+		test->ping->post();
+		test->pong->wait();
+		uint64_t back = now_ns();
+		test->round_trips.push_back(back - sent);
+		sent = back;
+	}
+	test->stop.store(true, memory_order_relaxed);
+	test->ping->post(); // Lets the other side see the stop flag
+	return NULL;
+}
+
+void *pong_side(void *arg)
+{
+	PingPong *test = (PingPong *)arg;
+	while (true)
+	{
+		test->ping->wait();
+		if (test->stop.load(memory_order_relaxed))
+			return NULL;
+		test->pong->post();
+	}
+}
+
+pthread_t start_thread(void *(*function)(void *), void *arg, int cpu)
+{
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	if (cpu >= 0)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+	}
+	pthread_t thread;
+	pthread_create(&thread, &attr, function, arg);
+	pthread_attr_destroy(&attr);
+	return thread;
+}
+
+void ping_pong(int primitive, const Placement &placement, double seconds)
+{
+	PingPong test;
+	test.ping = make_signal(primitive);
+	test.pong = make_signal(primitive);
+	test.seconds = seconds;
+	test.round_trips.reserve(1 << 20);
+	pthread_t b = start_thread(pong_side, &test, placement.cpu_b);
+	pthread_t a = start_thread(ping_side, &test, placement.cpu_a);
+	pthread_join(a, NULL);
+	pthread_join(b, NULL);
+	delete test.ping;
+	delete test.pong;
+
+	vector<uint64_t> &samples = test.round_trips;
+	sort(samples.begin(), samples.end());
+	uint64_t total = 0;
+	for (uint64_t sample : samples)
+		total += sample;
+	printf("%-12s %-14s %12.2f %12.2f %14.0f\n", primitives[primitive], placement.name,
+		   samples[samples.size() / 2] / 1000.0, samples[min(samples.size() - 1, samples.size() * 99 / 100)] / 1000.0,
+		   samples.size() / (total / 1e9));
+	fflush(stdout);
+}
+
+// ---------------------------------------------------------------------------
+// Handoff ring
+// ---------------------------------------------------------------------------
+struct Ring
+{
+	vector<Signal *> signals;
+	double seconds;
+	atomic<bool> stop{false};
+	long handoffs = 0; // Counted by thread 0, one per full lap times the ring size
+};
+
+struct RingMember
+{
+	Ring *ring;
+	int index;
+};
+
+void *ring_member(void *arg)
+{
+	RingMember *member = (RingMember *)arg;
+	Ring *ring = member->ring;
+	int size = ring->signals.size();
+	Signal *mine = ring->signals[member->index], *next = ring->signals[(member->index + 1) % size];
+	if (member->index == 0)
+	{
+		uint64_t deadline = now_ns() + (uint64_t)(ring->seconds * 1e9);
+		long laps = 0;
+		while (now_ns() < deadline)
+		{
+			next->post();
+			mine->wait();
+			laps++;
+		}
+		ring->stop.store(true, memory_order_relaxed);
+		next->post(); // One more lap tells everybody to stop
+		mine->wait();
+		ring->handoffs = laps * size;
+		return NULL;
+	}
+	while (true)
+	{
+		mine->wait();
+		bool stop = ring->stop.load(memory_order_relaxed);
+		next->post();
+		if (stop)
+			return NULL;
+	}
+}
+
+void handoff_ring(int primitive, int size, double seconds)
+{
+	Ring ring;
+	ring.seconds = seconds;
+	for (int i = 0; i < size; i++)
+		ring.signals.push_back(make_signal(primitive));
+	vector<RingMember> members(size);
+	vector<pthread_t> threads(size);
+	uint64_t begin = now_ns();
+	for (int i = size - 1; i >= 0; i--)
+	{
+		members[i] = {&ring, i};
+		threads[i] = start_thread(ring_member, &members[i], -1);
+	}
+	for (pthread_t &thread : threads)
+		pthread_join(thread, NULL);
+	double elapsed = (now_ns() - begin) / 1e9;
+	for (Signal *signal : ring.signals)
+		delete signal;
+	printf("%-12s %8d %14.0f %12.2f\n", primitives[primitive], size, ring.handoffs / elapsed,
+		   ring.handoffs ? elapsed * 1e6 / ring.handoffs : 0.0);
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 0.3;
+	int ring_threads = argc > 2 ? atoi(argv[2]) : 8;
+	if (seconds <= 0 || ring_threads < 2)
+	{
+		printf("Usage: ./a.out [seconds_per_test] [ring_threads]\n");
+		return 0;
+	}
+
+	vector<Cpu> cpus = online_cpus();
+	vector<Placement> pairs = placements(cpus);
+	printf("%zu usable CPUs; %.2f s per test\n", cpus.size(), seconds);
+	for (const Placement &placement : pairs)
+	{
+		if (placement.cpu_a < 0)
+			printf("  %-14s %s\n", placement.name, placement.available ? "threads left to the scheduler" : "skipped (no such pair of CPUs)");
+		else
+			printf("  %-14s CPUs %d and %d\n", placement.name, placement.cpu_a, placement.cpu_b);
+	}
+
+	printf("\nPing-pong round trips\n");
+	printf("%-12s %-14s %12s %12s %14s\n", "primitive", "placement", "rtt_p50_us", "rtt_p99_us", "roundtrips/s");
+	for (const Placement &placement : pairs)
+		for (int primitive = 0; primitive < PRIMITIVE_COUNT; primitive++)
+			if (placement.available)
+				ping_pong(primitive, placement, seconds);
+
+	printf("\nHandoff ring, threads not pinned\n");
+	printf("%-12s %8s %14s %12s\n", "primitive", "threads", "handoffs/s", "us/handoff");
+	for (int primitive = 0; primitive < PRIMITIVE_COUNT; primitive++)
+		handoff_ring(primitive, ring_threads, seconds);
+	return 0;
+}
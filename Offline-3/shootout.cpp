@@ -0,0 +1,189 @@
+/*
+  This program compares the four implementations of the Shadows of Small Health spec in this directory
+  on identical inputs: x.cpp (condition-variable classes), y.cpp (semaphores with an atomic cancel
+  flag), z.cpp (polling condition-variable loop) and Shadows_of_Small_Health.cpp (reader-priority
+  semaphore pair).
+
+  Key points:
+    - Every variant is built from source with the same compiler flags into a temporary directory.
+    - Every variant runs on every input file, one at a time, with its output written to a scratch
+      file and stdout/stderr discarded.
+    - Resource usage comes from wait4() on the child, so it covers all threads of the run: user+sys
+      CPU time exposes busy-waiting (a program that mostly sleeps uses almost no CPU), and voluntary
+      vs involuntary context switches show blocking vs preemption.
+    - A run that exceeds the timeout is killed (SIGALRM armed before exec) and reported as such.
+
+  Compilation:
+    g++ -O2 shootout.cpp -o shootout.out
+
+  Usage:
+    ./shootout.out <input_file>... [--runs=<R>] [--timeout=<seconds>] [--cxxflags=<flags>]
+
+    Run from the directory that holds the sources. Each variant runs R times per input
+    (default 3); times and context switches are averaged, max RSS is the largest seen.
+    The timeout defaults to 120 seconds per run; flags default to "-O2".
+
+  Output:
+    One table per input file: wall time, user+sys CPU, CPU utilization, voluntary and involuntary
+    context switches, max RSS and the exit status of each variant.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct Variant
+{
+    const char *name;
+    const char *source;
+};
+
+const Variant variants[] = {
+    {"x (cond-var classes)", "x.cpp"},
+    {"y (semaphores + cancel flag)", "y.cpp"},
+    {"z (polling cond loop)", "z.cpp"},
+    {"Shadows (reader-priority sems)", "Shadows_of_Small_Health.cpp"},
+};
+const int VARIANT_COUNT = sizeof(variants) / sizeof(variants[0]);
+
+struct RunResult
+{
+    double wall = 0;
+    double cpu = 0;
+    long voluntary = 0;
+    long involuntary = 0;
+    long max_rss_kb = 0;
+    string status = "ok";
+};
+
+double seconds(const timeval &tv)
+{
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+RunResult run_once(const string &binary, const string &input, const string &output, int timeout)
+{
+    RunResult result;
+    auto begin = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        alarm(timeout); // Pending alarms survive exec
+        execl(binary.c_str(), binary.c_str(), input.c_str(), output.c_str(), (char *)NULL);
+        _exit(127);
+    }
+    if (pid < 0)
+    {
+        result.status = "fork failed";
+        return result;
+    }
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    result.wall = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    result.cpu = seconds(usage.ru_utime) + seconds(usage.ru_stime);
+    result.voluntary = usage.ru_nvcsw;
+    result.involuntary = usage.ru_nivcsw;
+    result.max_rss_kb = usage.ru_maxrss;
+    if (WIFSIGNALED(status))
+        result.status = WTERMSIG(status) == SIGALRM ? "timeout" : "signal " + to_string(WTERMSIG(status));
+    else if (WEXITSTATUS(status) != 0)
+        result.status = "exit " + to_string(WEXITSTATUS(status));
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    vector<string> inputs;
+    int runs = 3, timeout = 120;
+    string flags = "-O2";
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+        if (option.rfind("--runs=", 0) == 0)
+            runs = atoi(argv[i] + 7);
+        else if (option.rfind("--timeout=", 0) == 0)
+            timeout = atoi(argv[i] + 10);
+        else if (option.rfind("--cxxflags=", 0) == 0)
+            flags = option.substr(11);
+        else if (option.rfind("--", 0) == 0)
+            runs = 0; // Unknown option, fall through to the usage message
+        else
+            inputs.push_back(option);
+    }
+    if (inputs.empty() || runs <= 0 || timeout <= 0)
+    {
+        cout << "Usage: ./shootout.out <input_file>... [--runs=<R>] [--timeout=<seconds>] [--cxxflags=<flags>]" << endl;
+        return 0;
+    }
+
+    char scratch[] = "/tmp/shootout.XXXXXX";
+    if (mkdtemp(scratch) == NULL)
+    {
+        cout << "Cannot create a scratch directory" << endl;
+        return 0;
+    }
+    string dir = scratch;
+
+    vector<string> binaries(VARIANT_COUNT);
+    for (int v = 0; v < VARIANT_COUNT; v++)
+    {
+        binaries[v] = dir + "/" + to_string(v) + ".out";
+        string command = "g++ " + flags + " -pthread " + variants[v].source + " -o " + binaries[v];
+        cout << "Building " << variants[v].source << endl;
+        if (system(command.c_str()) != 0)
+            binaries[v].clear();
+    }
+
+    for (const string &input : inputs)
+    {
+        cout << endl
+             << "Input " << input << " (" << runs << " run" << (runs > 1 ? "s" : "") << " each)" << endl;
+        cout << left << setw(32) << "variant" << right << setw(10) << "wall_s" << setw(12) << "user+sys_s"
+             << setw(8) << "cpu%" << setw(10) << "vol_cs" << setw(10) << "invol_cs" << setw(12) << "max_rss_kb"
+             << "  status" << endl;
+        for (int v = 0; v < VARIANT_COUNT; v++)
+        {
+            cout << left << setw(32) << variants[v].name << right;
+            if (binaries[v].empty())
+            {
+                cout << setw(74) << "" << "  build failed" << endl;
+                continue;
+            }
+            RunResult total;
+            for (int r = 0; r < runs; r++)
+            {
+                RunResult result = run_once(binaries[v], input, dir + "/" + to_string(v) + ".txt", timeout);
+                total.wall += result.wall / runs;
+                total.cpu += result.cpu / runs;
+                total.voluntary += result.voluntary;
+                total.involuntary += result.involuntary;
+                total.max_rss_kb = max(total.max_rss_kb, result.max_rss_kb);
+                if (result.status != "ok")
+                    total.status = result.status;
+            }
+            cout << fixed << setprecision(3) << setw(10) << total.wall << setw(12) << total.cpu
+                 << setprecision(1) << setw(8) << (total.wall > 0 ? 100 * total.cpu / total.wall : 0)
+                 << setw(10) << total.voluntary / runs << setw(10) << total.involuntary / runs
+                 << setw(12) << total.max_rss_kb << "  " << total.status << endl;
+        }
+    }
+
+    string cleanup = "rm -rf " + dir;
+    if (system(cleanup.c_str()) != 0)
+        cerr << "Could not remove " << dir << endl;
+    return 0;
+}
@@ -14,7 +14,12 @@
     g++ -pthread student_report_printing.cpp -o a.out
 
   Usage:
-    ./a.out <input_file> <output_file>
+    ./a.out <input_file> <output_file> [--staff=<poll|event>]
+
+    --staff=event makes the staff event-driven instead of reviewing on a timer: each staff member
+    blocks on its own eventfd, every logbook entry is published to both, and a burst of entries made
+    during a review is coalesced into one wakeup. Shutdown is a final publish; entries coalesced into
+    it are still reviewed before the staff exit.
 
   Input:
     N M
@@ -28,12 +33,17 @@
 */
 
 #include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <pthread.h>
 #include <random>
 #include <semaphore.h>
+#include <string>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <vector>
 
@@ -57,6 +67,11 @@ sem_t station_sem[NUM_STATIONS];            // Semaphores for typewriting statio
 vector<sem_t> group_sem;                    // Semaphores for group synchronization
 std::atomic<bool> staff_cancel_flag(false); // Atomic flag to signal staff threads to cancel
 
+// Event-driven staff: one eventfd per staff member, written on every logbook entry
+bool staff_event_driven = false;
+int staff_eventfd[2] = {-1, -1};
+std::atomic<long> entries_published(0);
+
 // Timing functions
 auto start_time = chrono::high_resolution_clock::now();
 
@@ -108,6 +123,19 @@ void write_output(const string &output)
     pthread_mutex_unlock(&output_lock);
 }
 
+/**
+ * Wake both staff members; each eventfd counter adds up until the staff member reads it.
+ */
+void publish_logbook_entry()
+{
+    uint64_t one = 1;
+    for (int i = 0; i < 2; i++)
+    {
+        if (write(staff_eventfd[i], &one, sizeof(one)) != sizeof(one))
+            perror("eventfd write");
+    }
+}
+
 /**
  * Thread function for operatives.
  * @param arg Pointer to Operative struct.
@@ -151,11 +179,72 @@ void *operative_function(void *arg)
         write_output("Unit " + to_string(op->group_id) + " has completed intelligence distribution at time " +
                      to_string(get_time()) + "\n");
         sem_post(&writer_sem);
+        if (staff_event_driven)
+        {
+            entries_published++;
+            publish_logbook_entry();
+        }
     }
 
     return NULL;
 }
 
+/**
+ * Read the logbook once, with reader access.
+ * @param staff_id Staff ID.
+ */
+void review_logbook(int staff_id)
+{
+    // Reader access to logbook
+    pthread_mutex_lock(&reader_mutex);
+    reader_count++;
+    if (reader_count == 1)
+    {
+        sem_wait(&writer_sem); // First reader blocks writers
+    }
+    pthread_mutex_unlock(&reader_mutex);
+
+    // Read logbook
+    int ops = operations_completed;
+    write_output("Intelligence Staff " + to_string(staff_id) + " began reviewing logbook at time " +
+                 to_string(get_time()) + ". Operations completed = " + to_string(ops) + "\n");
+
+    // Release reader access
+    pthread_mutex_lock(&reader_mutex);
+    reader_count--;
+    if (reader_count == 0)
+    {
+        sem_post(&writer_sem); // Last reader unblocks writers
+    }
+    pthread_mutex_unlock(&reader_mutex);
+}
+
+/**
+ * Event-driven staff: block until logbook entries (or shutdown) are published, then review.
+ * @param staff_id Staff ID.
+ */
+void event_driven_staff(int staff_id)
+{
+    long reviewed = 0; // Entries published before this staff member's last review began
+    while (true)
+    {
+        uint64_t entries;
+        if (read(staff_eventfd[staff_id - 1], &entries, sizeof(entries)) != sizeof(entries))
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (staff_cancel_flag)
+            break;
+        reviewed = entries_published;
+        review_logbook(staff_id);
+    }
+    // Entries coalesced into the shutdown wakeup have not been reviewed yet
+    if (entries_published > reviewed)
+        review_logbook(staff_id);
+}
+
 /**
  * Thread function for intelligence staff.
  * @param arg Pointer to staff ID.
@@ -163,33 +252,17 @@ void *operative_function(void *arg)
 void *staff_function(void *arg)
 {
     int staff_id = *(int *)arg;
+    if (staff_event_driven)
+    {
+        event_driven_staff(staff_id);
+        return NULL;
+    }
     while (true)
     {
         int sleep_time = get_random_number() % 10 + 1; // Random interval 1-10 seconds
         usleep(sleep_time * SLEEP_MULTIPLIER * 1000);
 
-        // Reader access to logbook
-        pthread_mutex_lock(&reader_mutex);
-        reader_count++;
-        if (reader_count == 1)
-        {
-            sem_wait(&writer_sem); // First reader blocks writers
-        }
-        pthread_mutex_unlock(&reader_mutex);
-
-        // Read logbook
-        int ops = operations_completed;
-        write_output("Intelligence Staff " + to_string(staff_id) + " began reviewing logbook at time " +
-                     to_string(get_time()) + ". Operations completed = " + to_string(ops) + "\n");
-
-        // Release reader access
-        pthread_mutex_lock(&reader_mutex);
-        reader_count--;
-        if (reader_count == 0)
-        {
-            sem_post(&writer_sem); // Last reader unblocks writers
-        }
-        pthread_mutex_unlock(&reader_mutex);
+        review_logbook(staff_id);
 
         if (staff_cancel_flag)
             break; // Exit loop if cancel flag is set
@@ -202,11 +275,27 @@ void *staff_function(void *arg)
  */
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    bool valid = argc == 3 || argc == 4;
+    if (argc == 4)
     {
-        cout << "Usage: ./a.out <input_file> <output_file>" << endl;
+        string option = argv[3];
+        valid = option == "--staff=poll" || option == "--staff=event";
+        staff_event_driven = option == "--staff=event";
+    }
+    if (!valid)
+    {
+        cout << "Usage: ./a.out <input_file> <output_file> [--staff=<poll|event>]" << endl;
         return 0;
     }
+    for (int i = 0; i < 2 && staff_event_driven; i++)
+    {
+        staff_eventfd[i] = eventfd(0, EFD_CLOEXEC);
+        if (staff_eventfd[i] < 0)
+        {
+            perror("eventfd");
+            staff_event_driven = false; // Fall back to reviewing on a timer
+        }
+    }
 
     // Redirect input/output
     ifstream inputFile(argv[1]);
@@ -273,10 +362,17 @@ int main(int argc, char *argv[])
     }
 
     staff_cancel_flag = true;
+    if (staff_event_driven)
+        publish_logbook_entry(); // Wakes idle staff so they see the shutdown
     for (int i = 0; i < 2; i++)
     {
         pthread_join(staff_threads[i], NULL);
     }
+    for (int i = 0; i < 2; i++)
+    {
+        if (staff_eventfd[i] >= 0)
+            close(staff_eventfd[i]);
+    }
 
     // Clean up
     pthread_mutex_destroy(&output_lock);
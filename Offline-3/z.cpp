@@ -2,6 +2,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <semaphore.h>
+#include <sys/eventfd.h>
 using namespace std;
 
 #define NUM_STATIONS 4
@@ -24,6 +25,11 @@ pthread_mutex_t logbook_mutex; // Mutex for logbook
 pthread_mutex_t output_mutex;  // Mutex for output
 pthread_cond_t cond;           // pthread cond
 pthread_mutex_t cond_mutex;    // mutex cv
+// --staff=event: staff block on their own eventfd, written on every logbook entry, instead of polling
+bool staff_event_driven = false;
+int staff_eventfd[2] = {-1, -1};
+atomic<long> entries_published(0);
+atomic<bool> staff_shutdown(false);
 auto start_time = chrono::high_resolution_clock::now();
 long long get_time()
 {
@@ -66,41 +72,80 @@ public:
         is_leader = id % m == 0;
     }
 };
+void publish_logbook_entry()
+{
+    uint64_t one = 1;
+    for (int i = 0; i < 2; i++)
+    {
+        if (write(staff_eventfd[i], &one, sizeof(one)) != sizeof(one))
+            perror("eventfd write");
+    }
+}
+void review_logbook(int staff_id)
+{
+    pthread_mutex_lock(&logbook_mutex);
+    waiting_readers++;
+    while (is_writer_active)
+    {
+        pthread_mutex_unlock(&logbook_mutex);
+        pthread_mutex_lock(&cond_mutex);
+        pthread_cond_wait(&cond, &cond_mutex);
+        pthread_mutex_unlock(&cond_mutex);
+        pthread_mutex_lock(&logbook_mutex);
+    }
+    waiting_readers--;
+    active_readers++;
+    pthread_mutex_unlock(&logbook_mutex);
+    int ops;
+    pthread_mutex_lock(&logbook_mutex);
+    ops = operations_completed;
+    pthread_mutex_unlock(&logbook_mutex);
+    usleep(get_random_number() * 100);
+    write_output("Intelligence Staff " + to_string(staff_id) +
+                 " began reviewing logbook at time " + to_string(get_time()) +
+                 " ms. Operations completed = " + to_string(ops) + "\n");
+    pthread_mutex_lock(&logbook_mutex);
+    active_readers--;
+    if (active_readers == 0)
+    {
+        pthread_cond_broadcast(&cond); // Notify all
+    }
+    pthread_mutex_unlock(&logbook_mutex);
+}
+void event_driven_reader(int staff_id)
+{
+    long reviewed = 0; // Entries published before the last review began
+    uint64_t entries;
+    while (true)
+    {
+        if (read(staff_eventfd[staff_id - 1], &entries, sizeof(entries)) != sizeof(entries))
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (staff_shutdown)
+            break;
+        reviewed = entries_published;
+        review_logbook(staff_id);
+    }
+    // Entries coalesced into the shutdown wakeup are still reviewed
+    if (entries_published > reviewed)
+        review_logbook(staff_id);
+}
 void *intelligence_reader(void *arg)
 {
     int staff_id = *(int *)arg;
+    if (staff_event_driven)
+    {
+        event_driven_reader(staff_id);
+        return nullptr;
+    }
     while (operations_completed < N / M)
     {
         int delay = get_random_number();
         usleep(delay * 100);
-        pthread_mutex_lock(&logbook_mutex);
-        waiting_readers++;
-        while (is_writer_active)
-        {
-            pthread_mutex_unlock(&logbook_mutex);
-            pthread_mutex_lock(&cond_mutex);
-            pthread_cond_wait(&cond, &cond_mutex);
-            pthread_mutex_unlock(&cond_mutex);
-            pthread_mutex_lock(&logbook_mutex);
-        }
-        waiting_readers--;
-        active_readers++;
-        pthread_mutex_unlock(&logbook_mutex);
-        int ops;
-        pthread_mutex_lock(&logbook_mutex);
-        ops = operations_completed;
-        pthread_mutex_unlock(&logbook_mutex);
-        usleep(get_random_number() * 100);
-        write_output("Intelligence Staff " + to_string(staff_id) +
-                     " began reviewing logbook at time " + to_string(get_time()) +
-                     " ms. Operations completed = " + to_string(ops) + "\n");
-        pthread_mutex_lock(&logbook_mutex);
-        active_readers--;
-        if (active_readers == 0)
-        {
-            pthread_cond_broadcast(&cond); // Notify all
-        }
-        pthread_mutex_unlock(&logbook_mutex);
+        review_logbook(staff_id);
         // Exit read
         usleep(get_random_number() * 100);
     }
@@ -155,17 +200,33 @@ void *operative_worker(void *arg)
         is_writer_active = false;
         pthread_cond_broadcast(&cond); // notify all
         pthread_mutex_unlock(&logbook_mutex);
+        if (staff_event_driven)
+        {
+            entries_published++;
+            publish_logbook_entry();
+        }
     }
     usleep(get_random_number() * SLEEP_MULTIPLIER);
     return nullptr;
 }
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    bool valid = argc == 3 || (argc == 4 && (string(argv[3]) == "--staff=poll" || string(argv[3]) == "--staff=event"));
+    if (!valid)
     {
-        cout << "Usage: ./a.out <input_file> <output_file>" << endl;
+        cout << "Usage: ./a.out <input_file> <output_file> [--staff=<poll|event>]" << endl;
         return 0;
     }
+    staff_event_driven = argc == 4 && string(argv[3]) == "--staff=event";
+    for (int i = 0; i < 2 && staff_event_driven; i++)
+    {
+        staff_eventfd[i] = eventfd(0, EFD_CLOEXEC);
+        if (staff_eventfd[i] < 0)
+        {
+            perror("eventfd");
+            staff_event_driven = false; // Fall back to polling
+        }
+    }
     // File handling for input and output redirection
     ifstream inputFile(argv[1]);
     streambuf *cinBuffer = cin.rdbuf(); // Save original cin buffer
@@ -208,10 +269,18 @@ int main(int argc, char *argv[])
     {
         pthread_join(operative_threads[i], nullptr);
     }
+    staff_shutdown = true;
+    if (staff_event_driven)
+        publish_logbook_entry(); // Wakes idle staff so they see the shutdown
     for (int i = 0; i < 2; i++)
     {
         pthread_join(staff_threads[i], nullptr);
     }
+    for (int i = 0; i < 2; i++)
+    {
+        if (staff_eventfd[i] >= 0)
+            close(staff_eventfd[i]);
+    }
     pthread_mutex_destroy(&logbook_mutex);
     pthread_mutex_destroy(&output_mutex);
     pthread_cond_destroy(&cond);